@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "../control/simulation.h"
+#include "../lib/arena.h"
+#include "../lib/util.h"
+#include "../model/minefield.h"
+#include "../solver/solver.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+* Whole headless games on the classic board sizes, on a FixedMinefield and on a Minefield.
+* Both play the exact same games, so the difference is only the board representation.
+*/
+namespace {
+
+constexpr unsigned games_per_run = 20;
+
+template<typename Play>
+int play_games(util::GameSettings settings, Play play) {
+	int num_won = 0;
+	for (unsigned seed = 0; seed < games_per_run; ++seed) {
+		num_won += play(settings, seed, {}).won;
+	}
+	return num_won;
+}
+
+// Written by winmine_find_worst, read from the working directory
+char const* const worst_positions_path = "worst_positions.txt";
+
+// Nodes a corpus board is searched for. The corpus keeps positions the solver didn't finish, those run to here.
+constexpr std::uint64_t corpus_node_limit = 1 << 20;
+
+struct CorpusBoard {
+	std::string label;
+	std::shared_ptr<Minefield> board;
+};
+
+// Boards as winmine_find_worst writes them: a comment line, then rows of 'b' for a mine, 'o' for exposed and
+// '.' for covered, with an empty line after each board
+std::vector<CorpusBoard> load_corpus(std::string const& path) {
+	std::vector<CorpusBoard> corpus;
+	std::ifstream file{ path };
+	std::string label;
+	std::vector<std::string> rows;
+
+	auto finish_board = [&]() {
+		if (rows.empty()) {
+			return;
+		}
+		int const width = static_cast<int>(rows.front().size());
+		int const height = static_cast<int>(rows.size());
+		std::vector<util::Pos> mines;
+		std::vector<util::Pos> exposed;
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width && x < static_cast<int>(rows[y].size()); ++x) {
+				if (rows[y][x] == 'b') {
+					mines.push_back({ x, y });
+				}
+				else if (rows[y][x] == 'o') {
+					exposed.push_back({ x, y });
+				}
+			}
+		}
+		auto board = std::make_shared<Minefield>(width, height, mines);
+		board->expose_many(exposed);
+		corpus.push_back({ std::to_string(corpus.size() + 1) + ". " + label, std::move(board) });
+		rows.clear();
+	};
+
+	for (std::string line; std::getline(file, line);) {
+		if (line.empty()) {
+			finish_board();
+		}
+		else if (line[0] == '#') {
+			label = line.substr(1);
+		}
+		else {
+			rows.push_back(line);
+		}
+	}
+	finish_board();
+	return corpus;
+}
+
+} // end anonymous namespace
+
+TEST_CASE("Classic boards, fixed vs dynamic size", "[!benchmark]") {
+	util::GameSettings const beginner{ 9, 9, 10 };
+	util::GameSettings const intermediate{ 16, 16, 40 };
+	util::GameSettings const expert{ 30, 16, 99 };
+
+	BENCHMARK("Beginner, fixed") { return play_games(beginner, simulation::play_game); };
+	BENCHMARK("Beginner, dynamic") { return play_games(beginner, simulation::play_game_dynamic); };
+	BENCHMARK("Intermediate, fixed") { return play_games(intermediate, simulation::play_game); };
+	BENCHMARK("Intermediate, dynamic") { return play_games(intermediate, simulation::play_game_dynamic); };
+	BENCHMARK("Expert, fixed") { return play_games(expert, simulation::play_game); };
+	BENCHMARK("Expert, dynamic") { return play_games(expert, simulation::play_game_dynamic); };
+}
+
+// Positions the solver was slowest on when they were found, to catch the search blowing up again
+TEST_CASE("Worst positions found so far", "[!benchmark]") {
+	std::vector<CorpusBoard> const corpus = load_corpus(worst_positions_path);
+	if (corpus.empty()) {
+		WARN("No positions in " << worst_positions_path << ", make them with winmine_find_worst");
+		return;
+	}
+
+	util::Arena arena;
+	solver::board_state_result result;
+	for (CorpusBoard const& entry : corpus) {
+		BENCHMARK(std::string{ entry.label }) {
+			solver::SearchControl control;
+			control.set_node_limit(corpus_node_limit);
+			solver::find_next_moves(*entry.board, arena, result, &control);
+			return result.num_solutions;
+		};
+	}
+}
@@ -1,75 +1,416 @@
 #include "controller.h"
 
+#include <algorithm>
 #include <functional>
 #include <chrono>
+#include <exception>
+#include <future>
 #include <thread>
+#include <tuple>
 
 #include "../model/minefield.h"
+#include "../solver/opening_book.h"
 #include "../solver/solver.h"
+#include "../lib/metrics.h"
+#include "../lib/trace.h"
 #include "../lib/util.h"
 
 using util::Pos;
 
-void Controller::update_view() {
-    if (update_view_callback) {
-        update_view_callback(minefield);
+namespace {
+
+// The controller whose thread this is, if any
+thread_local Controller const* running_controller = nullptr;
+
+} // end anonymous namespace
+
+Controller::Controller(Minefield&& m)
+    : minefield{ std::move(m) }
+    , published_state{ minefield.get_state() }
+    , owner{ [this]() { run(); } }
+{}
+
+Controller::~Controller() {
+    post([this]() {
+        cancel_search(); // its thread posts to us when done, so it has to be gone before we are
+        stopping = true;
+        });
+    owner.join();
+}
+
+void Controller::post(Command command) {
+    commands.push(std::move(command));
+    if (owner_waiting) {
+        // Taking the lock makes sure the owner is either before its last check of the queue, or already waiting
+        std::lock_guard<std::mutex> lock{ wake_mutex };
+        wake.notify_one();
+    }
+}
+
+/*
+* The controller thread. Runs commands in the order they were posted, and autoplay moves when they are due.
+*/
+void Controller::run() {
+    running_controller = this;
+    TRACE_THREAD_NAME("controller");
+    while (true) {
+        while (std::optional<Command> command = commands.pop()) {
+            (*command)();
+        }
+        if (stopping) {
+            return;
+        }
+
+        // While a search runs, autoplay waits for its result
+        bool const autoplay_waiting = autoplay && !pending_search;
+        if (autoplay_waiting && Clock::now() >= autoplay->next_move) {
+            autoplay_step();
+            continue;
+        }
+
+        // Nothing to do, sleep until a command is posted or the next autoplay move is due
+        std::unique_lock<std::mutex> lock{ wake_mutex };
+        owner_waiting = true;
+        auto has_command = [this]() { return !commands.empty(); };
+        if (autoplay_waiting) {
+            wake.wait_until(lock, autoplay->next_move, has_command);
+        }
+        else {
+            wake.wait(lock, has_command);
+        }
+        owner_waiting = false;
+    }
+}
+
+bool Controller::on_owner_thread() const {
+    return running_controller == this;
+}
+
+std::shared_ptr<Minefield const> Controller::make_snapshot() const {
+    return std::make_shared<Minefield const>(minefield);
+}
+
+std::shared_ptr<Minefield const> Controller::snapshot() {
+    if (on_owner_thread()) {
+        return make_snapshot();
+    }
+    std::promise<std::shared_ptr<Minefield const>> promise;
+    std::future<std::shared_ptr<Minefield const>> result = promise.get_future();
+    post([this, &promise]() { promise.set_value(make_snapshot()); });
+    return result.get();
+}
+
+void Controller::publish_changes() {
+    std::vector<Pos> changed = minefield.take_changed_cells();
+    GameState const state = minefield.get_state();
+    if (changed.empty() && state == published_state) {
+        return;
+    }
+
+    // A flood fill or a double toggle can list a cell more than once
+    std::sort(changed.begin(), changed.end(), [](Pos const& lhs, Pos const& rhs) {
+        return std::tie(lhs.y, lhs.x) < std::tie(rhs.y, rhs.x);
+        });
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    Minefield const& board = minefield;
+    BoardDelta delta;
+    delta.cells.reserve(changed.size());
+    for (Pos const& pos : changed) {
+        delta.cells.push_back({ pos, board.get_cell(pos) });
+    }
+    if (state != published_state) {
+        delta.game_state = state;
+        published_state = state;
+    }
+
+    std::shared_ptr<Minefield const> snapshot; // only made if someone wants it
+    for (Subscription const& sub : subscriptions) {
+        if (sub.on_delta) {
+            sub.on_delta(delta);
+        }
+        else {
+            if (!snapshot) {
+                snapshot = make_snapshot();
+            }
+            sub.on_snapshot(snapshot);
+        }
+    }
+}
+
+void Controller::publish_snapshot() {
+    minefield.take_changed_cells(); // all included in the snapshot
+    published_state = minefield.get_state();
+    std::shared_ptr<Minefield const> const snapshot = make_snapshot();
+    for (Subscription const& sub : subscriptions) {
+        sub.on_snapshot(snapshot);
     }
 }
 
 void Controller::expose(util::Pos pos) {
-    std::cout << "Exposing " << pos << '\n';
-    minefield.expose(pos);
-    update_view();
+    post([this, pos]() {
+        cancel_search();
+        std::cout << "Exposing " << pos << '\n';
+        history.record(minefield);
+        minefield.expose(pos);
+        publish_changes();
+        });
+}
+
+void Controller::expose_many(std::vector<util::Pos> const& positions) {
+    post([this, positions]() {
+        cancel_search();
+        history.record(minefield);
+        minefield.expose_many(positions);
+        publish_changes();
+        });
+}
+
+void Controller::chord(util::Pos pos) {
+    post([this, pos]() {
+        cancel_search();
+        history.record(minefield);
+        minefield.chord(pos);
+        publish_changes();
+        });
 }
 
 void Controller::toggle_flagged(Pos pos) {
-    minefield.toggle_flagged(pos);
-    update_view();
+    post([this, pos]() {
+        history.record(minefield);
+        minefield.toggle_flagged(pos);
+        publish_changes();
+        });
 }
 
 void Controller::new_game(util::GameSettings game_settings) {
-    minefield = Minefield{ game_settings };
-    update_view();
+    post([this, game_settings]() {
+        autoplay.reset();
+        cancel_search();
+        speculator.cancel();
+        history.clear();
+        minefield = Minefield{ game_settings };
+        num_guesses = 0;
+        publish_snapshot();
+        });
 }
 
-void Controller::auto_one_move() {
-    auto const& moves = solver::find_best_moves(minefield);
-    if (!moves.empty()) {
-        expose(moves.back());
+void Controller::undo() {
+    post([this]() {
+        autoplay.reset();
+        cancel_search();
+        speculator.cancel();
+        if (std::optional<Minefield> previous = history.undo(minefield)) {
+            minefield = std::move(*previous);
+            publish_snapshot();
+        }
+        });
+}
+
+void Controller::redo() {
+    post([this]() {
+        autoplay.reset();
+        cancel_search();
+        speculator.cancel();
+        if (std::optional<Minefield> next = history.redo(minefield)) {
+            minefield = std::move(*next);
+            publish_snapshot();
+        }
+        });
+}
+
+void Controller::search_then(std::function<void(solver::board_state_result const&)> use_result) {
+    cancel_search();
+    int const id = next_search_id++;
+    solver::AsyncSearch search = solver::find_next_moves_async(make_snapshot(), [this, id]() {
+        post([this, id]() { finish_search(id); });
+        });
+    std::atomic_store(&search_control, search.get_control());
+    pending_search.emplace(PendingSearch{ id, minefield.get_version(), Clock::now(), std::move(search), std::move(use_result) });
+}
+
+void Controller::finish_search(int id) {
+    if (!pending_search || pending_search->id != id) {
+        return; // dropped since
     }
-    else {
-        expose({ rand() % minefield.get_width(), rand() % minefield.get_height() });
+    PendingSearch done = std::move(*pending_search);
+    pending_search.reset();
+    std::atomic_store(&search_control, std::shared_ptr<solver::SearchControl const>{});
+
+    solver::board_state_result result;
+    try {
+        result = done.search.get();
+    }
+    catch (std::exception const& e) {
+        // The same board would fail the same way, so autoplay stops rather than asking again
+        std::cout << "The solver failed: " << e.what() << '\n';
+        autoplay.reset();
+        return;
+    }
+    // Searches cut short would make the solver look faster than it is
+    if (result.complete) {
+        util::metrics::record(util::metrics::Histogram::MoveSolveTime,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - done.started).count());
+    }
+    // Flags don't count, the solver doesn't look at them
+    if (result.complete && done.version == minefield.get_version()) {
+        done.use_result(result);
     }
 }
 
-void Controller::auto_play(std::chrono::milliseconds delay) {
-    while (!minefield.is_game_lost() && !minefield.is_game_won()) {
-        solver::board_state_result result = solver::explore_possible_minefield_states(minefield);
-        if (!result.safest_positions.empty()) {
-            expose(result.safest_positions.back());
+void Controller::cancel_search() {
+    pending_search.reset();
+    std::atomic_store(&search_control, std::shared_ptr<solver::SearchControl const>{});
+}
+
+std::optional<double> Controller::search_progress() const {
+    if (std::shared_ptr<solver::SearchControl const> const control = std::atomic_load(&search_control)) {
+        return control->get_progress();
+    }
+    return {};
+}
+
+// Runs on the controller thread
+void Controller::play_move(solver::board_state_result const& result) {
+    TRACE_SCOPE("autoplay move");
+    history.record(minefield);
+    if (!result.safest_positions.empty() && result.safe_certainty == 1) {
+        // All of them are safe, so they are played as one move
+        minefield.expose_many(result.safest_positions);
+    }
+    else {
+        Pos const pos = !result.safest_positions.empty() ?
+            result.safest_positions.back() :
+            solver::best_blind_click(minefield);
+        num_guesses += minefield.count_exposed_cells() > 0; // the first click isn't a guess, it can't go wrong
+        std::cout << "Exposing " << pos << '\n';
+        minefield.expose(pos);
+    }
+    if (result.unsafe_certainty > .99) {
+        for (Pos bomb : result.unsafest_positions) {
+            minefield.make_flagged(bomb);
         }
-        else {
-            expose({ rand() % minefield.get_width(), rand() % minefield.get_height() });
+    }
+    if (minefield.is_game_lost() || minefield.is_game_won()) {
+        util::metrics::record_game({ minefield.get_width(), minefield.get_height(), minefield.get_num_mines() },
+            minefield.is_game_won(), num_guesses);
+    }
+    publish_changes();
+}
+
+/*
+* Play the move for the board as it is, from the speculator when it already has it, otherwise once a search is
+* done. The run loop doesn't step again while that search is pending.
+*/
+void Controller::autoplay_step() {
+    if (minefield.is_game_lost() || minefield.is_game_won()) {
+        autoplay.reset();
+        return;
+    }
+
+    auto play_and_schedule = [this](solver::board_state_result const& result) {
+        play_move(result);
+        if (!autoplay) {
+            return;
         }
-        if (result.unsafe_certainty > .99) {
-            flag_positions(result.unsafest_positions);
+        autoplay->next_move = Clock::now() + autoplay->delay;
+        if (!minefield.is_game_lost() && !minefield.is_game_won()) {
+            speculator.speculate(make_snapshot());
         }
-        std::this_thread::sleep_for(delay);
+    };
+    if (std::optional<solver::board_state_result> const speculated = speculator.take(minefield.get_hash())) {
+        play_and_schedule(*speculated);
     }
+    else {
+        search_then(play_and_schedule);
+    }
+}
+
+void Controller::auto_one_move() {
+    post([this]() {
+        search_then([this](solver::board_state_result const& result) {
+            Pos const pos = !result.safest_positions.empty() ?
+                result.safest_positions.back() :
+                solver::best_blind_click(minefield);
+            std::cout << "Exposing " << pos << '\n';
+            history.record(minefield);
+            minefield.expose(pos);
+            publish_changes();
+            });
+        });
+}
+
+void Controller::auto_play(std::chrono::milliseconds delay) {
+    post([this, delay]() {
+        autoplay = Autoplay{ delay, Clock::now() };
+        });
+}
+
+void Controller::stop_autoplay() {
+    post([this]() {
+        autoplay.reset();
+        cancel_search();
+        speculator.cancel();
+        });
 }
 
 void Controller::flag_positions(std::vector<util::Pos> const& positions) {
-    for (util::Pos pos : positions) {
-        minefield.make_flagged(pos);
-    }
+    post([this, positions]() {
+        history.record(minefield);
+        for (util::Pos pos : positions) {
+            minefield.make_flagged(pos);
+        }
+        publish_changes();
+        });
 }
 
 void Controller::auto_flag_bombs() {
-    flag_positions(solver::find_bombs(minefield));
-    update_view();
+    post([this]() {
+        search_then([this](solver::board_state_result const& result) {
+            if (result.unsafe_certainty <= .99) { // mark them as bombs if we are 99% certain
+                return;
+            }
+            history.record(minefield);
+            for (util::Pos pos : result.unsafest_positions) {
+                minefield.make_flagged(pos);
+            }
+            publish_changes();
+            });
+        });
 }
 
-void Controller::set_update_view_callback(std::function<void(Minefield const&)> cb) {
-    std::cout << "Setting update view CB\n";
-    update_view_callback = cb;
-}
\ No newline at end of file
+Controller::SubscriptionId Controller::subscribe_deltas(DeltaCallback on_delta, SnapshotCallback on_snapshot) {
+    SubscriptionId const id = next_subscription_id++;
+    post([this, id, on_delta, on_snapshot]() {
+        subscriptions.push_back({ id, on_delta, on_snapshot });
+        on_snapshot(make_snapshot());
+        });
+    return id;
+}
+
+Controller::SubscriptionId Controller::subscribe_snapshots(SnapshotCallback on_snapshot) {
+    SubscriptionId const id = next_subscription_id++;
+    post([this, id, on_snapshot]() {
+        subscriptions.push_back({ id, nullptr, on_snapshot });
+        on_snapshot(make_snapshot());
+        });
+    return id;
+}
+
+void Controller::unsubscribe(SubscriptionId id) {
+    post([this, id]() {
+        subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(), [id](Subscription const& sub) {
+            return sub.id == id;
+            }), subscriptions.end());
+        });
+}
+
+void Controller::request_snapshot(SubscriptionId id) {
+    post([this, id]() {
+        for (Subscription const& sub : subscriptions) {
+            if (sub.id == id) {
+                sub.on_snapshot(make_snapshot());
+            }
+        }
+        });
+}
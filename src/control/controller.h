@@ -1,40 +1,166 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
+#include <vector>
 
+#include "speculation.h"
+#include "../model/history.h"
 #include "../model/minefield.h"
 #include "../solver/solver.h"
+#include "../lib/mpsc_queue.h"
 #include "../lib/util.h"
 
+// New content of one cell that changed
+struct CellChange {
+    util::Pos pos;
+    Cell cell;
+};
+
+// Everything that changed on the board in one controller operation
+struct BoardDelta {
+    std::vector<CellChange> cells;        // every changed cell once
+    std::optional<GameState> game_state;  // set when the game moved to a new state
+};
+
+/*
+* Owns the minefield and is the only one to touch it.
+* All public operations are queued as commands and run in order on the controller's own thread, so the GUI,
+* autoplay and anyone else can call them from any thread without locking. They return right away.
+* Observers are called on the controller thread, and get either deltas or immutable snapshots of the board.
+*/
 class Controller {
+public:
+    using DeltaCallback = std::function<void(BoardDelta const&)>;
+    using SnapshotCallback = std::function<void(std::shared_ptr<Minefield const> const&)>;
+    using SubscriptionId = int;
+
+private:
+    using Command = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    // A subscriber without a delta callback gets a full snapshot on every update
+    struct Subscription {
+        SubscriptionId id;
+        DeltaCallback on_delta;
+        SnapshotCallback on_snapshot;
+    };
+
+    // Autoplay runs as one move per step on the controller thread, so commands get in between moves
+    struct Autoplay {
+        std::chrono::milliseconds delay;
+        Clock::time_point next_move;
+    };
+
+    // A solver search on its own thread, its result is used unless the board has changed by then
+    struct PendingSearch {
+        int id;
+        std::uint64_t version; // Minefield::get_version() of the searched board
+        Clock::time_point started;
+        solver::AsyncSearch search;
+        std::function<void(solver::board_state_result const&)> use_result;
+    };
+
+    // Only used on the controller thread
     Minefield minefield;
-    std::function<void(Minefield const&)> update_view_callback; // register to receive callback 
-                                                                // when the minefield is updated
+    History history; // states before each change, for undo
+    std::vector<Subscription> subscriptions; // notified when the minefield is updated
+    GameState published_state = GameState::Uninitialized; // game state the subscribers know about
+    std::optional<Autoplay> autoplay;
+    std::optional<PendingSearch> pending_search; // only one at a time, a new one replaces it
+    int next_search_id = 0;
+    int num_guesses = 0; // autoplay moves this game on a cell that wasn't certain to be safe
+    bool stopping = false;
+
+    std::atomic<SubscriptionId> next_subscription_id{ 0 };
+
+    // Solves ahead while autoplay waits for its next move
+    Speculator speculator;
 
-    void update_view();
+    // Progress of the pending search, for other threads
+    std::shared_ptr<solver::SearchControl const> search_control;
+
+    // Commands from any thread. The mutex is only used to sleep when there is nothing to do.
+    util::MpscQueue<Command> commands;
+    std::atomic<bool> owner_waiting{ false };
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+
+    std::thread owner; // started last, everything above must exist when it runs
+
+    void post(Command command);
+    void run();
+    bool on_owner_thread() const;
+
+    // Search the board on another thread, and call use_result with the result back on the controller thread
+    void search_then(std::function<void(solver::board_state_result const&)> use_result);
+    void finish_search(int id);
+    // Drop the pending search, if any, it stops right away
+    void cancel_search();
+
+    void play_move(solver::board_state_result const& result);
+    void autoplay_step();
+
+    std::shared_ptr<Minefield const> make_snapshot() const;
+    // Send what changed since the last publish to all subscribers
+    void publish_changes();
+    // Send the whole board to all subscribers, used when the board is replaced
+    void publish_snapshot();
 
 public:
-    Controller::Controller(Minefield&& m)
-        : minefield{ std::move(m) }
-    {}
+    Controller(Minefield&& m);
     Controller(Controller&) = delete;
-    
-    Minefield const& get_minefield() { return minefield;  }
+    ~Controller();
+
+    /*
+    * Copy of the board after every command posted before this call has run.
+    * Blocks until then, except when called from the controller thread (in a callback).
+    */
+    std::shared_ptr<Minefield const> snapshot();
 
     void expose(util::Pos pos);
+    // Expose a whole set of cells as one move, one undo step and one delta
+    void expose_many(std::vector<util::Pos> const& positions);
+    // Expose the unflagged neighbours of a number that has all its flags
+    void chord(util::Pos pos);
 
     void toggle_flagged(util::Pos pos);
 
+    // Also stops autoplay
     void new_game(util::GameSettings game_settings);
 
+    // Step back and forth through the moves of this game. Also stop autoplay.
+    void undo();
+    void redo();
+
+    // The solver commands search on another thread, and only change the board once the search is done.
+    // Any change to the board, or another search, drops a search that is still running.
     void auto_one_move();
+    // Keep making moves, delay apart, until the game is over, stop_autoplay() or new_game()
     void auto_play(std::chrono::milliseconds delay);
+    // Also drops a running search
+    void stop_autoplay();
     void auto_flag_bombs();
 
+    // How far the running search is, from 0 to 1. Empty when nothing is being searched. Any thread can call this.
+    std::optional<double> search_progress() const;
+
     void flag_positions(std::vector<util::Pos> const& positions);
 
-    void set_update_view_callback(std::function<void(Minefield const&)> cb);
+    /*
+    * Get a BoardDelta with the changed cells after every update, coalesced per operation.
+    * on_snapshot gets the whole board right away, whenever a new game starts, and on request_snapshot().
+    */
+    SubscriptionId subscribe_deltas(DeltaCallback on_delta, SnapshotCallback on_snapshot);
+    // Get the whole board after every update
+    SubscriptionId subscribe_snapshots(SnapshotCallback on_snapshot);
+    void unsubscribe(SubscriptionId id);
+    void request_snapshot(SubscriptionId id);
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,67 @@
+#include "simulation.h"
+
+#include "../model/fixed_minefield.h"
+#include "../model/minefield.h"
+
+namespace simulation {
+
+namespace {
+
+template<int Width, int Height>
+GameResult play_fixed(util::GameSettings settings, unsigned seed, util::Arena& arena, std::optional<util::Pos> first_click) {
+    FixedMinefield<Width, Height> board{ settings.num_bombs, seed };
+    return play_game_on(board, arena, first_click);
+}
+
+} // end anonymous namespace
+
+GameResult play_game(util::GameSettings settings, unsigned seed, std::optional<util::Pos> first_click) {
+    thread_local util::Arena arena;
+
+    if (settings.width == 9 && settings.height == 9) {
+        return play_fixed<9, 9>(settings, seed, arena, first_click);
+    }
+    if (settings.width == 16 && settings.height == 16) {
+        return play_fixed<16, 16>(settings, seed, arena, first_click);
+    }
+    if (settings.width == 30 && settings.height == 16) {
+        return play_fixed<30, 16>(settings, seed, arena, first_click);
+    }
+    Minefield board{ settings, seed };
+    return play_game_on(board, arena, first_click);
+}
+
+GameResult play_game_dynamic(util::GameSettings settings, unsigned seed, std::optional<util::Pos> first_click) {
+    thread_local util::Arena arena;
+
+    Minefield board{ settings, seed };
+    return play_game_on(board, arena, first_click);
+}
+
+std::vector<solver::OpeningBook::Opening> generate_openings(util::GameSettings settings, int games_per_cell) {
+    int const width = settings.width;
+    int const height = settings.height;
+    std::vector<solver::OpeningBook::Opening> openings(width * height);
+
+    for (int y = 0; y < (height + 1) / 2; ++y) {
+        for (int x = 0; x < (width + 1) / 2; ++x) {
+            int num_opened = 0;
+            int num_won = 0;
+            for (int game = 0; game < games_per_cell; ++game) {
+                GameResult const result = play_game(settings, static_cast<unsigned>(game), util::Pos{ x, y });
+                num_opened += result.opened;
+                num_won += result.won;
+            }
+            solver::OpeningBook::Opening const opening{
+                static_cast<float>(num_opened) / games_per_cell, static_cast<float>(num_won) / games_per_cell };
+            for (int mirror_y : { y, height - 1 - y }) {
+                for (int mirror_x : { x, width - 1 - x }) {
+                    openings[mirror_y * width + mirror_x] = opening;
+                }
+            }
+        }
+    }
+    return openings;
+}
+
+} // namespace simulation
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "../lib/arena.h"
+#include "../lib/metrics.h"
+#include "../lib/trace.h"
+#include "../lib/util.h"
+#include "../solver/opening_book.h"
+#include "../solver/solver.h"
+
+/*
+* Headless games, the solver playing against itself with nobody watching.
+* The classic board sizes are played on a FixedMinefield, everything else on a Minefield.
+*/
+namespace simulation {
+
+struct GameResult {
+    bool won = false;
+    int moves = 0;   // clicks, including the first one. All cells known to be safe are exposed in one move.
+    int guesses = 0; // clicks on a cell the solver could not prove safe
+    bool opened = false; // the first click exposed a zero
+};
+
+inline bool operator==(GameResult const& lhs, GameResult const& rhs) {
+    return lhs.won == rhs.won && lhs.moves == rhs.moves && lhs.guesses == rhs.guesses && lhs.opened == rhs.opened;
+}
+
+/*
+* Play a fresh board to the end. solver::find_next_moves picks the moves, and when there is nothing to go on
+* solver::best_blind_click does, unless a first click is given. Board is Minefield or a FixedMinefield.
+*/
+template<typename Board>
+GameResult play_game_on(Board& board, util::Arena& arena, std::optional<util::Pos> first_click = {}) {
+    solver::board_state_result result;
+    GameResult game;
+
+    while (!board.is_game_lost() && !board.is_game_won()) {
+        TRACE_SCOPE("simulated move");
+        util::Pos pos;
+        if (game.moves > 0) {
+            util::metrics::Timer const timer{ util::metrics::Histogram::MoveSolveTime };
+            solver::find_next_moves(board, arena, result);
+        }
+        if (game.moves > 0 && !result.safest_positions.empty() && result.safe_certainty == 1) {
+            board.expose_many(result.safest_positions);
+            ++game.moves;
+            continue;
+        }
+        if (game.moves > 0 && !result.safest_positions.empty()) {
+            pos = result.safest_positions.back();
+            ++game.guesses;
+        }
+        else {
+            pos = game.moves == 0 && first_click ? *first_click : solver::best_blind_click(board);
+            game.guesses += game.moves > 0;
+        }
+        board.expose(pos);
+        if (game.moves == 0) {
+            game.opened = board.get_cell(pos).is_exposed() && board.get_cell(pos).get_num_adjacent_bombs() == 0;
+        }
+        ++game.moves;
+    }
+
+    game.won = board.is_game_won();
+    util::metrics::record_game({ board.get_width(), board.get_height(), board.get_num_mines() }, game.won, game.guesses);
+    return game;
+}
+
+// Play one game of the given size, on a FixedMinefield when there is one for that size
+GameResult play_game(util::GameSettings settings, unsigned seed, std::optional<util::Pos> first_click = {});
+
+// Same game as play_game, always on a Minefield
+GameResult play_game_dynamic(util::GameSettings settings, unsigned seed, std::optional<util::Pos> first_click = {});
+
+/*
+* Fill an opening book entry by playing games_per_cell games from every first click, seeds 0 and up.
+* Boards are symmetric under mirroring, so only one quadrant is played and mirrored to the others.
+*/
+std::vector<solver::OpeningBook::Opening> generate_openings(util::GameSettings settings, int games_per_cell);
+
+} // namespace simulation
@@ -0,0 +1,279 @@
+#include "speculation.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include "../lib/arena.h"
+#include "../lib/trace.h"
+
+using util::Pos;
+
+namespace {
+
+// A board as it would look with one more cell exposed, showing number. Enough of a board for the solver.
+class RevealedBoard {
+    Minefield const& board;
+    Pos reveal;
+    Cell revealed;
+
+public:
+    RevealedBoard(Minefield const& board, Pos reveal, int number)
+        : board{ board }
+        , reveal{ reveal }
+    {
+        revealed.set_num_adjacent_bombs(number);
+        revealed.expose();
+    }
+
+    int get_width() const { return board.get_width(); }
+    int get_height() const { return board.get_height(); }
+    int get_num_mines() const { return board.get_num_mines(); }
+    int count_exposed_cells() const { return board.count_exposed_cells() + 1; }
+
+    Cell const& get_cell(Pos const& pos) const {
+        return pos == reveal ? revealed : board.get_cell(pos);
+    }
+};
+
+// Minefield::get_hash() after reveal shows number, and the covered cells among flags are flagged
+std::uint64_t hash_after(Minefield const& board, Pos reveal, int number, std::vector<Pos> const& flags) {
+    int const width = board.get_width();
+    int const index = reveal.y * width + reveal.x;
+    std::uint64_t hash = board.get_hash();
+    hash ^= zobrist::cell_key(index, zobrist::look_of(board.get_cell(reveal)));
+    hash ^= zobrist::cell_key(index, 2 + number);
+    for (Pos const& flag : flags) {
+        if (!(flag == reveal) && board.get_cell(flag).state == CellState::Covered) {
+            hash ^= zobrist::cell_key(flag.y * width + flag.x, 1);
+        }
+    }
+    return hash;
+}
+
+} // end anonymous namespace
+
+Speculator::Speculator(int num_threads)
+    : num_threads{ num_threads }
+    , control{ std::make_shared<solver::SearchControl>() }
+{}
+
+Speculator::~Speculator() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+        control->cancel();
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int Speculator::default_num_threads() {
+    int const num_cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(num_cores - 1, 1, 4); // leave a core for the controller and the GUI
+}
+
+void Speculator::speculate(std::shared_ptr<Minefield const> board) {
+    std::lock_guard<std::mutex> lock{ mutex };
+    ++generation;
+    current_board = board;
+    current_hash = board->get_hash();
+    current_followed_up = false;
+
+    // Queued work was for earlier boards. Results of the last round stay, one of them may be this board.
+    jobs.clear();
+    for (auto it = results.begin(); it != results.end();) {
+        if (it->second.done && it->second.generation + 1 < generation) {
+            it = results.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    if (workers.empty()) {
+        for (int i = 0; i < num_threads; ++i) {
+            workers.emplace_back([this]() { run(); });
+        }
+    }
+    jobs.push_back({ current_hash, std::move(board), std::nullopt, 0 });
+    work_ready.notify_one();
+}
+
+std::optional<solver::board_state_result> Speculator::take(std::uint64_t hash) {
+    std::lock_guard<std::mutex> lock{ mutex };
+
+    // Not started yet, the caller is better off solving it right away
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [hash](Job const& job) {
+        return job.hash == hash;
+        }), jobs.end());
+
+    auto const it = results.find(hash);
+    if (it == results.end() || !it->second.done) {
+        ++num_misses;
+        return {};
+    }
+    ++num_hits;
+    return it->second.result;
+}
+
+void Speculator::cancel() {
+    std::lock_guard<std::mutex> lock{ mutex };
+    ++generation;
+    current_board = nullptr;
+    current_hash = 0;
+    current_followed_up = true;
+    jobs.clear();
+
+    // Entries in the works stay until their worker is done with them, it drops them as the solve is cut short
+    control->cancel();
+    control = std::make_shared<solver::SearchControl>();
+    for (auto it = results.begin(); it != results.end();) {
+        it = it->second.done ? results.erase(it) : std::next(it);
+    }
+}
+
+void Speculator::wait_idle() {
+    std::unique_lock<std::mutex> lock{ mutex };
+    result_ready.wait(lock, [this]() { return jobs.empty() && num_running == 0; });
+}
+
+int Speculator::get_num_hits() {
+    std::lock_guard<std::mutex> lock{ mutex };
+    return num_hits;
+}
+
+int Speculator::get_num_misses() {
+    std::lock_guard<std::mutex> lock{ mutex };
+    return num_misses;
+}
+
+/*
+* A worker. Solves the jobs in order, and once the board last passed to speculate() is solved, queues the
+* positions after its next move. That board may already have been solved, or be in the works, as one of the
+* positions after the board before it, whichever worker sees its result first does the follow up.
+* Done entries are only ever erased by speculate() and cancel(), so an entry stays put while its worker has the
+* lock released. A solve that cancel() cut short leaves no entry.
+*/
+void Speculator::run() {
+    TRACE_THREAD_NAME("speculation");
+    std::unique_lock<std::mutex> lock{ mutex };
+    while (true) {
+        work_ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping) {
+            return;
+        }
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        ++num_running;
+
+        auto it = results.find(job.hash);
+        if (it == results.end()) {
+            Entry& entry = results[job.hash];
+            entry.generation = generation;
+            std::shared_ptr<solver::SearchControl> const job_control = control;
+            lock.unlock();
+            solver::board_state_result result;
+            solve(job, *job_control, result);
+            lock.lock();
+            if (result.complete) {
+                entry.result = std::move(result);
+                entry.done = true;
+                it = results.find(job.hash);
+            }
+            else {
+                results.erase(job.hash);
+                it = results.end();
+            }
+        }
+
+        if (it != results.end() && job.hash == current_hash && it->second.done && !current_followed_up) {
+            current_followed_up = true;
+            std::shared_ptr<Minefield const> const board = current_board;
+            solver::board_state_result const result = it->second.result;
+            lock.unlock();
+            std::vector<Job> follow_ups = follow_up_jobs(board, result);
+            lock.lock();
+            if (board == current_board) {
+                std::move(follow_ups.begin(), follow_ups.end(), std::back_inserter(jobs));
+                work_ready.notify_all();
+            }
+        }
+
+        --num_running;
+        result_ready.notify_all();
+    }
+}
+
+void Speculator::solve(Job const& job, solver::SearchControl& control, solver::board_state_result& result) {
+    TRACE_SCOPE("speculative solve");
+    thread_local util::Arena arena;
+    if (!job.reveal) {
+        solver::find_next_moves(*job.board, arena, result, &control);
+        return;
+    }
+    RevealedBoard const board{ *job.board, *job.reveal, job.number };
+    solver::find_next_moves(board, arena, result, &control);
+}
+
+/*
+* Same choice of move as Controller::play_move. The numbers the exposed cell can show are ranked taking its
+* neighbours to be mines independently: the cells in result with the odds it gives them, the others with the
+* share of mines among all covered cells. That is not exact, but only decides which positions are tried, and
+* costs nothing next to another search of the board.
+*/
+std::vector<Speculator::Job> Speculator::follow_up_jobs(std::shared_ptr<Minefield const> const& board_ptr, solver::board_state_result const& result) {
+    Minefield const& board = *board_ptr;
+    if (result.safest_positions.empty() || (result.safe_certainty == 1 && result.safest_positions.size() != 1)) {
+        return {};
+    }
+    Pos const pos = result.safest_positions.back();
+    std::vector<Pos> flags;
+    if (result.unsafe_certainty > .99) {
+        flags = result.unsafest_positions;
+    }
+
+    auto contains = [](std::vector<Pos> const& positions, Pos pos) {
+        return std::find(positions.begin(), positions.end(), pos) != positions.end();
+    };
+    int const num_covered = board.get_width() * board.get_height() - board.count_exposed_cells();
+    double const density = static_cast<double>(board.get_num_mines()) / num_covered;
+    auto mine_probability = [&](Pos neighbour) {
+        if (board.get_cell(neighbour).is_exposed()) {
+            return 0.;
+        }
+        if (contains(result.unsafest_positions, neighbour)) {
+            return result.unsafe_certainty;
+        }
+        if (contains(result.safest_positions, neighbour)) {
+            return 1 - result.safe_certainty;
+        }
+        return density;
+    };
+
+    std::array<double, 9> odds{ 1. };
+    util::for_each_adjacent_position(pos, board.get_width(), board.get_height(), [&](Pos neighbour) {
+        double const p = mine_probability(neighbour);
+        for (int n = 8; n > 0; --n) {
+            odds[n] = odds[n] * (1 - p) + odds[n - 1] * p;
+        }
+        odds[0] *= 1 - p;
+        });
+
+    std::vector<int> numbers;
+    for (int n = 1; n <= 8; ++n) {
+        if (odds[n] > 0) {
+            numbers.push_back(n);
+        }
+    }
+    std::sort(numbers.begin(), numbers.end(), [&](int lhs, int rhs) { return odds[lhs] > odds[rhs]; });
+    numbers.resize(std::min<std::size_t>(numbers.size(), numbers_per_move));
+
+    std::vector<Job> follow_ups;
+    for (int number : numbers) {
+        follow_ups.push_back({ hash_after(board, pos, number, flags), board_ptr, pos, number });
+    }
+    return follow_ups;
+}
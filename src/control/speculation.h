@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../model/minefield.h"
+#include "../solver/solver.h"
+#include "../lib/util.h"
+
+/*
+* Solves the positions autoplay is about to reach on background threads, so their results are ready when it
+* gets there. Results are keyed by Minefield::get_hash(), and are what solver::find_next_moves gives.
+*
+* Given a board, it solves that board first. Then it follows the move the controller will make from there: when
+* that exposes a single cell, the positions where the cell shows its most likely numbers are solved too.
+* Zeros and batches of safe cells are not followed, they flood open too much of the board to guess.
+*/
+class Speculator {
+    // A board as it would look after its controller's next move, or the board itself when reveal is empty
+    struct Job {
+        std::uint64_t hash;
+        std::shared_ptr<Minefield const> board;
+        std::optional<util::Pos> reveal;
+        int number = 0; // shown on reveal
+    };
+
+    struct Entry {
+        std::uint64_t generation = 0; // of the board it was queued for
+        bool done = false; // otherwise a worker is solving it
+        solver::board_state_result result;
+    };
+
+    int const num_threads;
+    std::vector<std::thread> workers; // started on first use
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable result_ready;
+    std::deque<Job> jobs;
+    std::unordered_map<std::uint64_t, Entry> results;
+    std::uint64_t generation = 0; // counts the calls to speculate() and cancel()
+    std::shared_ptr<solver::SearchControl> control; // of the solves running now, replaced by cancel()
+    std::shared_ptr<Minefield const> current_board; // last passed to speculate()
+    std::uint64_t current_hash = 0;
+    bool current_followed_up = false; // the positions after current_board's next move are queued
+    int num_running = 0;
+    int num_hits = 0;
+    int num_misses = 0;
+    bool stopping = false;
+
+    void run();
+    void solve(Job const& job, solver::SearchControl& control, solver::board_state_result& result);
+    // The positions after the move the controller makes on board, given its result. Called unlocked.
+    std::vector<Job> follow_up_jobs(std::shared_ptr<Minefield const> const& board, solver::board_state_result const& result);
+
+public:
+    // Numbers to follow per speculated move, the most likely first
+    static constexpr int numbers_per_move = 2;
+
+    explicit Speculator(int num_threads = default_num_threads());
+    Speculator(Speculator&) = delete;
+    ~Speculator();
+
+    static int default_num_threads();
+
+    // Start working ahead from this board, and drop queued work for earlier boards
+    void speculate(std::shared_ptr<Minefield const> board);
+
+    // The result for a board with this hash, if it is done. Work in progress isn't waited for, that can't be
+    // cancelled, so the caller is better off with a search of its own.
+    std::optional<solver::board_state_result> take(std::uint64_t hash);
+
+    // Drop all queued work and results, and stop the solves that are running, within check_interval nodes.
+    // For when autoplay stops, nothing it worked ahead for is going to be asked for.
+    void cancel();
+
+    // Block until all queued work is done, for tests
+    void wait_idle();
+
+    int get_num_hits();
+    int get_num_misses();
+};
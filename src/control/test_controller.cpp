@@ -0,0 +1,192 @@
+#include "catch.hpp"
+
+#include "controller.h"
+#include "../model/minefield.h"
+#include "../lib/metrics.h"
+#include "../lib/util.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using util::Pos;
+
+TEST_CASE("Controller publishes changed cells", "[Controller]") {
+	// 4x3 with one bomb in the bottom right corner
+	Controller control{ Minefield{ 4, 3, { Pos{ 3, 2 } } } };
+
+	std::vector<BoardDelta> deltas;
+	int num_snapshots = 0;
+	Controller::SubscriptionId const id = control.subscribe_deltas(
+		[&deltas](BoardDelta const& delta) { deltas.push_back(delta); },
+		[&num_snapshots](std::shared_ptr<Minefield const> const&) { ++num_snapshots; });
+	control.snapshot(); // wait for the callbacks
+	REQUIRE(num_snapshots == 1);
+
+	SECTION("Flood fill") {
+		control.expose({ 0, 0 }); // opens everything but the bomb, which wins the game
+		control.snapshot();
+		REQUIRE(deltas.size() == 1);
+		REQUIRE(deltas[0].cells.size() == 11);
+		for (CellChange const& change : deltas[0].cells) {
+			REQUIRE(change.cell.is_exposed());
+		}
+		REQUIRE(deltas[0].game_state == GameState::Won);
+	}
+
+	SECTION("Flags") {
+		control.toggle_flagged({ 3, 2 });
+		control.snapshot();
+		REQUIRE(deltas.size() == 1);
+		REQUIRE(deltas[0].cells.size() == 1);
+		REQUIRE(deltas[0].cells[0].pos == Pos{ 3, 2 });
+		REQUIRE(deltas[0].cells[0].cell.is_flagged());
+		REQUIRE(!deltas[0].game_state);
+
+		control.expose({ 2, 1 }); // a number, nothing else opens
+		control.snapshot();
+		REQUIRE(deltas.size() == 2);
+		REQUIRE(deltas[1].cells.size() == 1);
+	}
+
+	SECTION("Snapshots on request and on new game") {
+		control.request_snapshot(id);
+		control.new_game({ 5, 5, 3 });
+		control.snapshot();
+		REQUIRE(num_snapshots == 3);
+		REQUIRE(deltas.empty());
+
+		control.unsubscribe(id);
+		control.expose({ 0, 0 });
+		control.snapshot();
+		REQUIRE(deltas.empty());
+	}
+}
+
+TEST_CASE("Autoplay runs on the controller thread", "[Controller]") {
+	Controller control{ Minefield{ util::GameSettings{ 9, 9, 10 } } };
+
+	SECTION("Plays until the game is over") {
+		control.auto_play(std::chrono::milliseconds{ 0 });
+		std::shared_ptr<Minefield const> board = control.snapshot();
+		for (int i = 0; i < 1000 && !board->is_game_won() && !board->is_game_lost(); ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+			board = control.snapshot();
+		}
+		REQUIRE((board->is_game_won() || board->is_game_lost()));
+	}
+
+	SECTION("A new game cancels it") {
+		control.auto_play(std::chrono::milliseconds{ 1000 }); // first move right away, then wait
+		control.new_game({ 9, 9, 10 });
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+		REQUIRE(control.snapshot()->count_exposed_cells() == 0);
+	}
+}
+
+namespace {
+
+void require_same_result(solver::board_state_result const& actual, solver::board_state_result const& expected) {
+	REQUIRE(actual.safest_positions == expected.safest_positions);
+	REQUIRE(actual.unsafest_positions == expected.unsafest_positions);
+	REQUIRE(actual.safe_certainty == expected.safe_certainty);
+	REQUIRE(actual.unsafe_certainty == expected.unsafe_certainty);
+	REQUIRE(actual.num_solutions == expected.num_solutions);
+}
+
+} // end anonymous namespace
+
+TEST_CASE("Speculative solving", "[Controller]") {
+	Speculator speculator{ 2 };
+	int num_moves = 0;
+	int num_guessed = 0;
+
+	// Play like the controller. Positions the speculator saw coming a move ahead must match a fresh solve.
+	for (unsigned seed = 0; seed < 20; ++seed) {
+		Minefield board{ util::GameSettings{ 9, 9, 10 }, seed };
+		board.expose({ 4, 4 });
+		while (!board.is_game_lost() && !board.is_game_won()) {
+			solver::board_state_result const expected = solver::find_next_moves(board);
+			if (std::optional<solver::board_state_result> const speculated = speculator.take(board.get_hash())) {
+				require_same_result(*speculated, expected);
+				++num_guessed;
+			}
+
+			speculator.speculate(std::make_shared<Minefield const>(board));
+			speculator.wait_idle();
+			std::optional<solver::board_state_result> const solved = speculator.take(board.get_hash());
+			REQUIRE(solved);
+			require_same_result(*solved, expected);
+
+			if (expected.safe_certainty == 1) {
+				board.expose_many(expected.safest_positions);
+			}
+			else {
+				board.expose(!expected.safest_positions.empty() ? expected.safest_positions.back() : Pos{ 0, 0 });
+			}
+			if (expected.unsafe_certainty > .99) {
+				for (Pos bomb : expected.unsafest_positions) {
+					board.make_flagged(bomb);
+				}
+			}
+			++num_moves;
+		}
+	}
+
+	REQUIRE(num_guessed > 0);
+	REQUIRE(speculator.get_num_hits() == num_moves + num_guessed);
+	REQUIRE(speculator.get_num_misses() == num_moves - num_guessed);
+}
+
+TEST_CASE("Changing the board drops a running search", "[Controller]") {
+	util::metrics::clear();
+
+	// Independent 1s with eight covered cells each, the search would take forever
+	std::vector<Pos> mines;
+	for (int i = 0; i < 20; ++i) {
+		mines.push_back({ 3 * i, 0 });
+	}
+	Controller control{ Minefield{ 60, 3, mines } };
+	for (int i = 0; i < 20; ++i) {
+		control.expose({ 3 * i + 1, 1 });
+	}
+	control.auto_one_move();
+	for (int i = 0; i < 2000 && !control.search_progress(); ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	REQUIRE(control.search_progress());
+
+	control.new_game({ 9, 9, 10 });
+	std::shared_ptr<Minefield const> const board = control.snapshot();
+	REQUIRE(!control.search_progress());
+	REQUIRE(board->get_width() == 9);
+	REQUIRE(board->count_exposed_cells() == 0);
+
+	// Only the search that got to the end counts as a solve
+	control.auto_one_move();
+	for (int i = 0; i < 2000 && control.snapshot()->count_exposed_cells() == 0; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	REQUIRE(util::metrics::snapshot()[util::metrics::Histogram::MoveSolveTime].count == 1);
+	util::metrics::clear();
+}
+
+TEST_CASE("Cancelling speculation stops a running solve", "[Controller]") {
+	// The same board as above, no worker would be done with it any time soon
+	std::vector<Pos> mines;
+	for (int i = 0; i < 20; ++i) {
+		mines.push_back({ 3 * i, 0 });
+	}
+	Minefield board{ 60, 3, mines };
+	for (int i = 0; i < 20; ++i) {
+		board.expose({ 3 * i + 1, 1 });
+	}
+
+	Speculator speculator{ 2 };
+	speculator.speculate(std::make_shared<Minefield const>(board));
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+	speculator.cancel();
+	speculator.wait_idle();
+	REQUIRE(!speculator.take(board.get_hash()));
+}
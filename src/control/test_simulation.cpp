@@ -0,0 +1,66 @@
+#include "catch.hpp"
+
+#include "simulation.h"
+#include "../lib/util.h"
+#include "../solver/opening_book.h"
+
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+TEST_CASE("Fixed size games play out like dynamic ones", "[Simulation]") {
+	util::GameSettings const sizes[] = { { 9, 9, 10 }, { 16, 16, 40 }, { 30, 16, 99 } };
+
+	for (util::GameSettings const& settings : sizes) {
+		int num_won = 0;
+		for (unsigned seed = 0; seed < 10; ++seed) {
+			simulation::GameResult const fixed = simulation::play_game(settings, seed);
+			simulation::GameResult const dynamic = simulation::play_game_dynamic(settings, seed);
+			REQUIRE(fixed == dynamic);
+			REQUIRE(fixed.moves > 0);
+			REQUIRE(fixed.guesses < fixed.moves);
+			num_won += fixed.won;
+		}
+		if (settings.num_bombs == 10) {
+			REQUIRE(num_won > 0);
+		}
+	}
+}
+
+TEST_CASE("Opening book", "[Simulation]") {
+	util::GameSettings const settings{ 5, 4, 3 };
+
+	SECTION("Without a book, the first click goes where a zero is most likely") {
+		REQUIRE(solver::best_first_click(settings, solver::OpeningBook{}) == util::Pos{ 0, 0 });
+		// 19 other cells take the 3 mines, and the 3 neighbours of a corner must stay clear
+		REQUIRE(solver::first_click_zero_probability(settings, { 0, 0 }) == Approx(16. / 19 * 15. / 18 * 14. / 17));
+		REQUIRE(solver::first_click_zero_probability(settings, { 2, 1 }) < solver::first_click_zero_probability(settings, { 2, 0 }));
+	}
+
+	SECTION("Played openings agree with the odds, and survive a round trip through a file") {
+		std::vector<solver::OpeningBook::Opening> const openings = simulation::generate_openings(settings, 200);
+		REQUIRE(openings.size() == 20);
+		for (int i = 0; i < 20; ++i) {
+			util::Pos const pos{ i % 5, i / 5 };
+			CAPTURE(pos);
+			REQUIRE(openings[i].zero_probability == Approx(solver::first_click_zero_probability(settings, pos)).margin(.12));
+		}
+
+		solver::OpeningBook book;
+		book.add(settings, openings);
+		std::string const path = "test_openings.bin";
+		REQUIRE(book.save(path));
+		std::optional<solver::OpeningBook> const loaded = solver::OpeningBook::load(path);
+		std::remove(path.c_str());
+		REQUIRE(loaded);
+		REQUIRE(loaded->find(settings) != nullptr);
+		REQUIRE(loaded->find({ 9, 9, 10 }) == nullptr);
+		REQUIRE((*loaded->find(settings))[7].win_probability == Approx(openings[7].win_probability).margin(1e-4));
+
+		util::Pos const best = solver::best_first_click(settings, *loaded);
+		for (solver::OpeningBook::Opening const& opening : openings) {
+			REQUIRE(opening.win_probability <= (*loaded->find(settings))[best.y * 5 + best.x].win_probability + 1e-4f);
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace util {
+
+namespace {
+
+std::size_t align_up(std::size_t offset, std::byte const* base, std::size_t alignment) {
+    auto const address = reinterpret_cast<std::uintptr_t>(base) + offset;
+    return offset + (alignment - address % alignment) % alignment;
+}
+
+} // end anonymous namespace
+
+Arena::Arena(std::size_t initial_block_size) {
+    blocks.push_back({ std::make_unique<std::byte[]>(initial_block_size), initial_block_size });
+}
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    // Try the current block, then any block we kept from earlier rounds
+    for (; current_block < blocks.size(); ++current_block, offset = 0) {
+        Block& block = blocks[current_block];
+        std::size_t const start = align_up(offset, block.data.get(), alignment);
+        if (start + bytes <= block.size) {
+            offset = start + bytes;
+            return block.data.get() + start;
+        }
+    }
+
+    // Out of space, grow. Only happens until the arena has seen the largest workload.
+    std::size_t const size = std::max(blocks.back().size * 2, bytes + alignment);
+    blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+    current_block = blocks.size() - 1;
+    Block& block = blocks.back();
+    std::size_t const start = align_up(0, block.data.get(), alignment);
+    offset = start + bytes;
+    return block.data.get() + start;
+}
+
+void Arena::reset() {
+    current_block = 0;
+    offset = 0;
+}
+
+std::size_t Arena::bytes_reserved() const {
+    std::size_t total = 0;
+    for (Block const& block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+} // namespace util
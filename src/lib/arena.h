@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace util {
+
+/*
+* Bump allocator for short-lived scratch memory.
+* Deallocation is a no-op, all memory is handed back at once with reset(). The blocks are kept
+* around after a reset, so once the arena has grown to fit a workload, repeating that workload
+* does not touch the heap at all.
+*/
+class Arena : public std::pmr::memory_resource {
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t current_block = 0;
+    std::size_t offset = 0; // first free byte in blocks[current_block]
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit Arena(std::size_t initial_block_size = 64 * 1024);
+    Arena(Arena&) = delete;
+
+    // Make all memory available again. Everything allocated from the arena is invalid afterwards.
+    void reset();
+
+    std::size_t bytes_reserved() const;
+};
+
+} // namespace util
@@ -0,0 +1,411 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace util::metrics {
+
+namespace buckets {
+
+namespace {
+
+// Position of the highest bit that is set, value must not be 0
+int highest_bit(std::uint64_t value) {
+    int bit = 0;
+    for (int step = 32; step > 0; step /= 2) {
+        if (value >> step) {
+            value >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+} // end anonymous namespace
+
+int index_of(std::uint64_t value) {
+    if (value < num_linear) {
+        return static_cast<int>(value);
+    }
+    int const bit = highest_bit(value);
+    int const shift = bit - sub_bucket_bits;
+    int const sub_bucket = static_cast<int>(value >> shift) - (1 << sub_bucket_bits);
+    return num_linear + (bit - sub_bucket_bits - 1) * (1 << sub_bucket_bits) + sub_bucket;
+}
+
+std::uint64_t lowest_value(int index) {
+    if (index < num_linear) {
+        return index;
+    }
+    int const shift = (index - num_linear) / (1 << sub_bucket_bits) + 1;
+    std::uint64_t const top = (index - num_linear) % (1 << sub_bucket_bits) + (1 << sub_bucket_bits);
+    return top << shift;
+}
+
+std::uint64_t highest_value(int index) {
+    if (index < num_linear) {
+        return index;
+    }
+    int const shift = (index - num_linear) / (1 << sub_bucket_bits) + 1;
+    std::uint64_t const top = (index - num_linear) % (1 << sub_bucket_bits) + (1 << sub_bucket_bits);
+    return ((top + 1) << shift) - 1; // wraps to the largest value for the last bucket
+}
+
+} // namespace buckets
+
+namespace {
+
+// Only its own thread writes a block, or whoever holds the registry lock, so a plain load and store will do
+void add(std::atomic<std::uint64_t>& counter, std::uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct HistogramCounts {
+    std::array<std::atomic<std::uint64_t>, buckets::num_buckets> counts;
+    std::atomic<std::uint64_t> sum;
+};
+
+struct GameCounts {
+    std::atomic<std::uint64_t> num_games;
+    std::atomic<std::uint64_t> num_won;
+};
+
+struct Block {
+    std::array<HistogramCounts, num_histograms> histograms;
+    std::array<GameCounts, max_configurations> configurations; // by registry slot
+
+    void add_to(Block& total) const {
+        for (int h = 0; h < num_histograms; ++h) {
+            for (int b = 0; b < buckets::num_buckets; ++b) {
+                add(total.histograms[h].counts[b], histograms[h].counts[b].load(std::memory_order_relaxed));
+            }
+            add(total.histograms[h].sum, histograms[h].sum.load(std::memory_order_relaxed));
+        }
+        for (int c = 0; c < max_configurations; ++c) {
+            add(total.configurations[c].num_games, configurations[c].num_games.load(std::memory_order_relaxed));
+            add(total.configurations[c].num_won, configurations[c].num_won.load(std::memory_order_relaxed));
+        }
+    }
+
+    void reset() {
+        for (HistogramCounts& histogram : histograms) {
+            for (std::atomic<std::uint64_t>& count : histogram.counts) {
+                count.store(0, std::memory_order_relaxed);
+            }
+            histogram.sum.store(0, std::memory_order_relaxed);
+        }
+        for (GameCounts& counts : configurations) {
+            counts.num_games.store(0, std::memory_order_relaxed);
+            counts.num_won.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+/*
+* The blocks of the running threads, and the sum of the ones that are gone. The lock is taken when a thread
+* starts or stops recording, and for a snapshot.
+* Configurations get a slot the first time a game on them is counted, by swapping their key into a free one.
+* The last slot is for all configurations that don't get one of their own.
+*/
+struct Registry {
+    std::mutex mutex;
+    std::vector<Block*> live;
+    std::unique_ptr<Block> retired = std::make_unique<Block>();
+    std::array<std::atomic<std::uint64_t>, max_configurations - 1> configuration_keys{}; // 0 is a free slot
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// A thread's block, added to the retired total when the thread ends
+class ThreadBlock {
+    std::unique_ptr<Block> block = std::make_unique<Block>();
+
+public:
+    ThreadBlock() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock{ reg.mutex };
+        reg.live.push_back(block.get());
+    }
+    ThreadBlock(ThreadBlock&) = delete;
+
+    ~ThreadBlock() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock{ reg.mutex };
+        block->add_to(*reg.retired);
+        reg.live.erase(std::find(reg.live.begin(), reg.live.end(), block.get()));
+    }
+
+    Block& get() { return *block; }
+};
+
+Block& this_thread_block() {
+    thread_local ThreadBlock block;
+    return block.get();
+}
+
+std::uint64_t configuration_key(GameSettings settings) {
+    return static_cast<std::uint64_t>(settings.width) << 42
+        | static_cast<std::uint64_t>(settings.height) << 21
+        | static_cast<std::uint64_t>(settings.num_bombs);
+}
+
+GameSettings settings_of(std::uint64_t key) {
+    constexpr std::uint64_t mask = (1 << 21) - 1;
+    return { static_cast<int>(key >> 42), static_cast<int>(key >> 21 & mask), static_cast<int>(key & mask) };
+}
+
+int configuration_slot(GameSettings settings) {
+    Registry& reg = registry();
+    std::uint64_t const key = configuration_key(settings);
+    for (int slot = 0; slot < max_configurations - 1; ++slot) {
+        std::uint64_t current = reg.configuration_keys[slot].load(std::memory_order_relaxed);
+        if (current == 0 && reg.configuration_keys[slot].compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+            return slot;
+        }
+        if (current == key) {
+            return slot;
+        }
+    }
+    return max_configurations - 1;
+}
+
+char const* const histogram_names[num_histograms] = { "move_solve_time_ns", "flood_fill_size", "guesses_per_game" };
+
+struct PrometheusSummary {
+    char const* name;
+    char const* help;
+    double scale; // from the recorded unit to the exported one
+};
+
+PrometheusSummary const prometheus_summaries[num_histograms] = {
+    { "winmine_move_solve_seconds", "Solver time per move.", 1e-9 },
+    { "winmine_flood_fill_cells", "Cells opened by one click.", 1 },
+    { "winmine_guesses_per_game", "Moves per game that were not certain to be safe.", 1 },
+};
+
+double const quantiles[] = { .5, .9, .99, .999 };
+
+std::string prometheus_labels(ConfigurationSnapshot const& configuration) {
+    if (configuration.other) {
+        return "{board=\"other\"}";
+    }
+    GameSettings const& settings = configuration.settings;
+    return "{board=\"" + std::to_string(settings.width) + "x" + std::to_string(settings.height) + "\",mines=\""
+        + std::to_string(settings.num_bombs) + "\"}";
+}
+
+} // end anonymous namespace
+
+std::uint64_t HistogramSnapshot::value_at_quantile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    std::uint64_t const rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(quantile * count)));
+    std::uint64_t seen = 0;
+    for (int b = 0; b < buckets::num_buckets; ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return buckets::highest_value(b);
+        }
+    }
+    return buckets::highest_value(buckets::num_buckets - 1);
+}
+
+void record(Histogram histogram, std::uint64_t value) {
+    HistogramCounts& counts = this_thread_block().histograms[static_cast<int>(histogram)];
+    add(counts.counts[buckets::index_of(value)], 1);
+    add(counts.sum, value);
+}
+
+void record_game(GameSettings settings, bool won, int guesses) {
+    GameCounts& counts = this_thread_block().configurations[configuration_slot(settings)];
+    add(counts.num_games, 1);
+    add(counts.num_won, won);
+    record(Histogram::GuessesPerGame, guesses);
+}
+
+Snapshot snapshot() {
+    Registry& reg = registry();
+    Block total;
+    total.reset();
+    {
+        std::lock_guard<std::mutex> lock{ reg.mutex };
+        reg.retired->add_to(total);
+        for (Block const* block : reg.live) {
+            block->add_to(total);
+        }
+    }
+
+    Snapshot result;
+    for (int h = 0; h < num_histograms; ++h) {
+        HistogramSnapshot& histogram = result.histograms[h];
+        for (int b = 0; b < buckets::num_buckets; ++b) {
+            histogram.counts[b] = total.histograms[h].counts[b].load(std::memory_order_relaxed);
+            histogram.count += histogram.counts[b];
+        }
+        histogram.sum = total.histograms[h].sum.load(std::memory_order_relaxed);
+    }
+    for (int c = 0; c < max_configurations; ++c) {
+        ConfigurationSnapshot configuration;
+        configuration.num_games = total.configurations[c].num_games.load(std::memory_order_relaxed);
+        configuration.num_won = total.configurations[c].num_won.load(std::memory_order_relaxed);
+        if (configuration.num_games == 0) {
+            continue;
+        }
+        if (c < max_configurations - 1) {
+            configuration.settings = settings_of(reg.configuration_keys[c].load(std::memory_order_relaxed));
+        }
+        else {
+            configuration.other = true;
+        }
+        result.configurations.push_back(configuration);
+    }
+    return result;
+}
+
+/*
+* Per histogram its count, sum, mean and quantiles, and its buckets that are not empty as [lowest, highest, count].
+* Per configuration its games, wins and win rate.
+*/
+void write_json(std::ostream& os, Snapshot const& snapshot) {
+    os << "{\"histograms\":{";
+    for (int h = 0; h < num_histograms; ++h) {
+        HistogramSnapshot const& histogram = snapshot.histograms[h];
+        os << (h > 0 ? "," : "") << "\n\"" << histogram_names[h] << "\":{\"count\":" << histogram.count
+            << ",\"sum\":" << histogram.sum << ",\"mean\":" << histogram.mean();
+        for (double quantile : quantiles) {
+            os << ",\"p" << quantile * 100 << "\":" << histogram.value_at_quantile(quantile);
+        }
+        os << ",\"buckets\":[";
+        bool first = true;
+        for (int b = 0; b < buckets::num_buckets; ++b) {
+            if (histogram.counts[b] > 0) {
+                os << (first ? "" : ",") << '[' << buckets::lowest_value(b) << ',' << buckets::highest_value(b)
+                    << ',' << histogram.counts[b] << ']';
+                first = false;
+            }
+        }
+        os << "]}";
+    }
+    os << "\n},\"configurations\":[";
+    for (std::size_t c = 0; c < snapshot.configurations.size(); ++c) {
+        ConfigurationSnapshot const& configuration = snapshot.configurations[c];
+        os << (c > 0 ? "," : "") << "\n{";
+        if (configuration.other) {
+            os << "\"other\":true";
+        }
+        else {
+            os << "\"width\":" << configuration.settings.width << ",\"height\":" << configuration.settings.height
+                << ",\"mines\":" << configuration.settings.num_bombs;
+        }
+        os << ",\"games\":" << configuration.num_games << ",\"won\":" << configuration.num_won
+            << ",\"win_rate\":" << configuration.win_rate() << '}';
+    }
+    os << "\n]}\n";
+}
+
+// The histograms as summaries with a few quantiles, the games as counters per board
+void write_prometheus(std::ostream& os, Snapshot const& snapshot) {
+    for (int h = 0; h < num_histograms; ++h) {
+        HistogramSnapshot const& histogram = snapshot.histograms[h];
+        PrometheusSummary const& summary = prometheus_summaries[h];
+        os << "# HELP " << summary.name << ' ' << summary.help << '\n'
+            << "# TYPE " << summary.name << " summary\n";
+        for (double quantile : quantiles) {
+            os << summary.name << "{quantile=\"" << quantile << "\"} "
+                << histogram.value_at_quantile(quantile) * summary.scale << '\n';
+        }
+        os << summary.name << "_sum " << histogram.sum * summary.scale << '\n'
+            << summary.name << "_count " << histogram.count << '\n';
+    }
+
+    os << "# HELP winmine_games_total Games played to the end.\n"
+        << "# TYPE winmine_games_total counter\n";
+    for (ConfigurationSnapshot const& configuration : snapshot.configurations) {
+        os << "winmine_games_total" << prometheus_labels(configuration) << ' ' << configuration.num_games << '\n';
+    }
+    os << "# HELP winmine_games_won_total Games won.\n"
+        << "# TYPE winmine_games_won_total counter\n";
+    for (ConfigurationSnapshot const& configuration : snapshot.configurations) {
+        os << "winmine_games_won_total" << prometheus_labels(configuration) << ' ' << configuration.num_won << '\n';
+    }
+}
+
+bool write_file(std::string const& path) {
+    Snapshot const counts = snapshot();
+    std::string const temporary = path + ".tmp";
+    {
+        std::ofstream file{ temporary };
+        if (!file) {
+            std::cout << "Could not open " << temporary << " to write the metrics\n";
+            return false;
+        }
+        bool const json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json) {
+            write_json(file, counts);
+        }
+        else {
+            write_prometheus(file, counts);
+        }
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::cout << "Could not replace " << path << ": " << error.message() << '\n';
+        return false;
+    }
+    return true;
+}
+
+void clear() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock{ reg.mutex };
+    reg.retired->reset();
+    for (Block* block : reg.live) {
+        block->reset();
+    }
+    for (std::atomic<std::uint64_t>& key : reg.configuration_keys) {
+        key.store(0, std::memory_order_relaxed);
+    }
+}
+
+FileExporter::FileExporter(std::string path, std::chrono::milliseconds interval)
+    : path{ std::move(path) }
+    , interval{ interval }
+    , writer{ [this]() { run(); } }
+{}
+
+FileExporter::~FileExporter() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+}
+
+void FileExporter::run() {
+    std::unique_lock<std::mutex> lock{ mutex };
+    while (true) {
+        bool const stop = wake.wait_for(lock, interval, [this]() { return stopping; });
+        lock.unlock();
+        write_file(path);
+        lock.lock();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+} // namespace util::metrics
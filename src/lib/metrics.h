@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+
+/*
+* Running statistics of play: how long the solver takes per move, how many cells a click opens, how many guesses
+* a game takes and how often it is won, per board size. Every thread counts into a block of its own with plain
+* relaxed stores, so recording takes no lock. The blocks of threads that are gone are added to a shared total,
+* and the histograms have a fixed number of buckets, so memory stays the same however long a run goes.
+*/
+
+namespace util::metrics {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Histogram {
+    MoveSolveTime,  // nanoseconds, for each move the solver is asked for
+    FloodFillSize,  // cells opened by one click
+    GuessesPerGame,
+};
+constexpr int num_histograms = 3;
+
+// Board configurations counted on their own. Games on any more than that are counted together, as other.
+constexpr int max_configurations = 16;
+
+/*
+* Log-linear buckets, as in an HDR histogram: one per value below 32, then 16 per power of two, so the bucket a
+* value falls in is at most 1/16 of the value wide. Together they cover every std::uint64_t.
+*/
+namespace buckets {
+
+constexpr int sub_bucket_bits = 4;
+constexpr int num_linear = 2 << sub_bucket_bits;
+constexpr int num_buckets = num_linear + (64 - sub_bucket_bits - 1) * (1 << sub_bucket_bits);
+
+int index_of(std::uint64_t value);
+std::uint64_t lowest_value(int index);
+std::uint64_t highest_value(int index);
+
+} // namespace buckets
+
+// A histogram added up over all threads
+struct HistogramSnapshot {
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(buckets::num_buckets, 0);
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+
+    double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0; }
+    // The highest value of the bucket the quantile falls in, 0 when empty
+    std::uint64_t value_at_quantile(double quantile) const;
+};
+
+struct ConfigurationSnapshot {
+    GameSettings settings{ 0, 0, 0 };
+    bool other = false; // the configurations past max_configurations together
+    std::uint64_t num_games = 0;
+    std::uint64_t num_won = 0;
+
+    double win_rate() const { return num_games > 0 ? static_cast<double>(num_won) / num_games : 0; }
+};
+
+struct Snapshot {
+    std::array<HistogramSnapshot, num_histograms> histograms;
+    std::vector<ConfigurationSnapshot> configurations; // the ones with games, in the order they were first played
+
+    HistogramSnapshot const& operator[](Histogram histogram) const { return histograms[static_cast<int>(histogram)]; }
+};
+
+// Count one value on the calling thread
+void record(Histogram histogram, std::uint64_t value);
+
+// Count a finished game, and its guesses
+void record_game(GameSettings settings, bool won, int guesses);
+
+// All counts so far, of all threads, also the ones that have finished
+Snapshot snapshot();
+
+void write_json(std::ostream& os, Snapshot const& snapshot);
+void write_prometheus(std::ostream& os, Snapshot const& snapshot);
+
+// Write a snapshot as JSON when the path ends in .json, Prometheus text otherwise. It goes to a temporary file
+// that is then renamed, so a reader never sees half a file. Returns false when the file can't be written.
+bool write_file(std::string const& path);
+
+// Forget all counts, on all threads. No other thread may be recording at the same time.
+void clear();
+
+// Records the time from construction to destruction, in nanoseconds
+class Timer {
+    Histogram histogram;
+    Clock::time_point start;
+
+public:
+    explicit Timer(Histogram histogram)
+        : histogram{ histogram }
+        , start{ Clock::now() }
+    {}
+    Timer(Timer&) = delete;
+
+    ~Timer() {
+        record(histogram, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+};
+
+/*
+* Rewrites a metrics file with write_file every interval, on a thread of its own, and a last time when it goes.
+* A Prometheus node exporter can pick the file up with its textfile collector.
+*/
+class FileExporter {
+    std::string const path;
+    std::chrono::milliseconds const interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread writer;
+
+    void run();
+
+public:
+    FileExporter(std::string path, std::chrono::milliseconds interval);
+    FileExporter(FileExporter&) = delete;
+    ~FileExporter();
+};
+
+} // namespace util::metrics
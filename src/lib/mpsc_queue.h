@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace util {
+
+/*
+* Unbounded lock-free queue for many producers and a single consumer (Vyukov's node based design).
+* push() can be called from any thread, it is one atomic exchange and one store.
+* pop() and empty() must only be called from the consumer thread.
+* All atomics are sequentially consistent, so a producer that pushes and then checks a "consumer is asleep"
+* flag can't miss a consumer that sets that flag and then checks empty().
+*/
+template<typename T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        std::optional<T> value;
+    };
+
+    std::atomic<Node*> head; // last pushed node, producers append after it
+    Node* tail;              // consumed node, the next one is the front of the queue
+
+public:
+    MpscQueue()
+        : head{ new Node{} }
+        , tail{ head.load() }
+    {}
+    MpscQueue(MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        while (pop()) {}
+        delete tail;
+    }
+
+    void push(T value) {
+        Node* node = new Node{};
+        node->value.emplace(std::move(value));
+        Node* prev = head.exchange(node);
+        prev->next.store(node);
+    }
+
+    std::optional<T> pop() {
+        Node* next = tail->next.load();
+        if (next == nullptr) {
+            return {};
+        }
+        std::optional<T> value = std::move(next->value);
+        next->value.reset();
+        delete tail;
+        tail = next;
+        return value;
+    }
+
+    // A push that is halfway done counts as empty, the producer wakes the consumer after it completes
+    bool empty() const {
+        return tail->next.load() == nullptr;
+    }
+};
+
+} // namespace util
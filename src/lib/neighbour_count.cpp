@@ -0,0 +1,157 @@
+#include "neighbour_count.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define WINMINE_X86_64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define WINMINE_TARGET_AVX2
+#else
+#define WINMINE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace util {
+
+namespace {
+
+/*
+* Every kernel works one output row at a time, on the (up to) three input rows around it.
+* rows[0..num_rows) are the present rows, center is the row of the output. Columns [begin, end) are done,
+* they must have a left and a right neighbour.
+*/
+struct RowJob {
+    std::uint8_t const* rows[3];
+    int num_rows;
+    std::uint8_t const* center;
+    std::uint8_t* out;
+};
+
+void box_sum_scalar(RowJob const& job, int begin, int end) {
+    for (int x = begin; x < end; ++x) {
+        int sum = 0;
+        for (int r = 0; r < job.num_rows; ++r) {
+            sum += job.rows[r][x - 1] + job.rows[r][x] + job.rows[r][x + 1];
+        }
+        job.out[x] = static_cast<std::uint8_t>(sum - job.center[x]);
+    }
+}
+
+#ifdef WINMINE_X86_64
+
+// Returns the first column that was not done
+int box_sum_sse2(RowJob const& job, int begin, int end) {
+    int x = begin;
+    for (; x + 16 <= end; x += 16) {
+        __m128i sum = _mm_setzero_si128();
+        for (int r = 0; r < job.num_rows; ++r) {
+            std::uint8_t const* row = job.rows[r] + x;
+            sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<__m128i const*>(row - 1)));
+            sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<__m128i const*>(row)));
+            sum = _mm_add_epi8(sum, _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + 1)));
+        }
+        __m128i const center = _mm_loadu_si128(reinterpret_cast<__m128i const*>(job.center + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(job.out + x), _mm_sub_epi8(sum, center));
+    }
+    return x;
+}
+
+WINMINE_TARGET_AVX2
+int box_sum_avx2(RowJob const& job, int begin, int end) {
+    int x = begin;
+    for (; x + 32 <= end; x += 32) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int r = 0; r < job.num_rows; ++r) {
+            std::uint8_t const* row = job.rows[r] + x;
+            sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(row - 1)));
+            sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(row)));
+            sum = _mm256_add_epi8(sum, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(row + 1)));
+        }
+        __m256i const center = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(job.center + x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(job.out + x), _mm256_sub_epi8(sum, center));
+    }
+    return x;
+}
+
+SimdLevel detect_simd_level() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] >= 7) {
+        __cpuid(regs, 1);
+        bool const os_saves_ymm = (regs[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(regs, 7, 0);
+        if (os_saves_ymm && (regs[1] & (1 << 5))) {
+            return SimdLevel::AVX2;
+        }
+    }
+    return SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+}
+
+#else
+
+SimdLevel detect_simd_level() {
+    return SimdLevel::Scalar;
+}
+
+#endif
+
+// The wall columns have only one horizontal neighbour, do them one at a time
+int edge_sum(RowJob const& job, int x, int width) {
+    int sum = 0;
+    for (int r = 0; r < job.num_rows; ++r) {
+        for (int dx = std::max(x - 1, 0); dx <= std::min(x + 1, width - 1); ++dx) {
+            sum += job.rows[r][dx];
+        }
+    }
+    return sum - job.center[x];
+}
+
+} // end anonymous namespace
+
+SimdLevel best_simd_level() {
+    static SimdLevel const level = detect_simd_level();
+    return level;
+}
+
+void count_neighbours(std::uint8_t const* plane, int width, int height, std::uint8_t* out) {
+    count_neighbours(plane, width, height, out, best_simd_level());
+}
+
+void count_neighbours(std::uint8_t const* plane, int width, int height, std::uint8_t* out, SimdLevel level) {
+    level = std::min(level, best_simd_level());
+
+    for (int y = 0; y < height; ++y) {
+        RowJob job{ {}, 0, plane + y * width, out + y * width };
+        for (int dy = -1; dy <= 1; ++dy) {
+            if (y + dy >= 0 && y + dy < height) {
+                job.rows[job.num_rows++] = plane + (y + dy) * width;
+            }
+        }
+
+        job.out[0] = static_cast<std::uint8_t>(edge_sum(job, 0, width));
+        if (width > 1) {
+            job.out[width - 1] = static_cast<std::uint8_t>(edge_sum(job, width - 1, width));
+        }
+
+        // Interior columns, as wide as the CPU allows, the scalar loop picks up the tail
+        int x = 1;
+#ifdef WINMINE_X86_64
+        if (level == SimdLevel::AVX2) {
+            x = box_sum_avx2(job, x, width - 1);
+        }
+        if (level >= SimdLevel::SSE2) {
+            x = box_sum_sse2(job, x, width - 1);
+        }
+#endif
+        box_sum_scalar(job, x, width - 1);
+    }
+}
+
+} // namespace util
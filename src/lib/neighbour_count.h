@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace util {
+
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Widest instruction set the kernels can use on this CPU, detected once
+SimdLevel best_simd_level();
+
+/*
+* For every cell of a width*height byte plane (row major, every byte 0 or 1), count how many of its up to 8
+* neighbours are set, and write that to out. This is a 3x3 box sum minus the centre, computed for the whole
+* board at once. plane and out must not overlap.
+*/
+void count_neighbours(std::uint8_t const* plane, int width, int height, std::uint8_t* out);
+
+// Same, with a specific implementation. Levels above best_simd_level() fall back to it.
+void count_neighbours(std::uint8_t const* plane, int width, int height, std::uint8_t* out, SimdLevel level);
+
+} // namespace util
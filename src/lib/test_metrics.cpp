@@ -0,0 +1,99 @@
+#include "catch.hpp"
+
+#include "metrics.h"
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using util::metrics::Histogram;
+
+TEST_CASE("Histogram buckets", "[Metrics]") {
+	namespace buckets = util::metrics::buckets;
+
+	// Every value lands in a bucket that holds it, and the buckets are in order without gaps
+	for (std::uint64_t value : { 0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456789ull, 1ull << 40, ~0ull }) {
+		int const index = buckets::index_of(value);
+		REQUIRE(index >= 0);
+		REQUIRE(index < buckets::num_buckets);
+		REQUIRE(buckets::lowest_value(index) <= value);
+		REQUIRE(buckets::highest_value(index) >= value);
+	}
+	for (int index = 1; index < buckets::num_buckets; ++index) {
+		REQUIRE(buckets::lowest_value(index) == buckets::highest_value(index - 1) + 1);
+		// At most 1/16 of the values in it wide
+		REQUIRE(buckets::highest_value(index) - buckets::lowest_value(index) <= buckets::lowest_value(index) / 16);
+	}
+	REQUIRE(buckets::highest_value(buckets::num_buckets - 1) == std::numeric_limits<std::uint64_t>::max());
+}
+
+TEST_CASE("Metrics from several threads", "[Metrics]") {
+	util::metrics::clear();
+
+	for (std::uint64_t value = 1; value <= 1000; ++value) {
+		util::metrics::record(Histogram::FloodFillSize, value);
+	}
+	// This thread is gone by the time of the snapshot, its counts stay
+	std::thread worker{ []() {
+		util::metrics::record_game({ 9, 9, 10 }, true, 1);
+		util::metrics::record_game({ 9, 9, 10 }, false, 3);
+		} };
+	worker.join();
+	util::metrics::record_game({ 9, 9, 10 }, true, 0);
+
+	util::metrics::Snapshot const snapshot = util::metrics::snapshot();
+	util::metrics::HistogramSnapshot const& sizes = snapshot[Histogram::FloodFillSize];
+	REQUIRE(sizes.count == 1000);
+	REQUIRE(sizes.sum == 500500);
+	REQUIRE(sizes.value_at_quantile(.5) >= 500);
+	REQUIRE(sizes.value_at_quantile(.5) <= 500 + 500 / 16);
+	REQUIRE(sizes.value_at_quantile(1) >= 1000);
+
+	REQUIRE(snapshot[Histogram::GuessesPerGame].count == 3);
+	REQUIRE(snapshot[Histogram::GuessesPerGame].sum == 4);
+	REQUIRE(snapshot.configurations.size() == 1);
+	REQUIRE(snapshot.configurations[0].settings.width == 9);
+	REQUIRE(snapshot.configurations[0].settings.num_bombs == 10);
+	REQUIRE(snapshot.configurations[0].num_games == 3);
+	REQUIRE(snapshot.configurations[0].num_won == 2);
+
+	util::metrics::clear();
+	REQUIRE(util::metrics::snapshot()[Histogram::FloodFillSize].count == 0);
+}
+
+TEST_CASE("Metrics stay the same size", "[Metrics]") {
+	util::metrics::clear();
+
+	// More board configurations than there are slots for, the rest are counted together
+	int const num_configurations = util::metrics::max_configurations + 10;
+	for (int mines = 1; mines <= num_configurations; ++mines) {
+		util::metrics::record_game({ 30, 16, mines }, true, 0);
+	}
+	util::metrics::Snapshot const snapshot = util::metrics::snapshot();
+	REQUIRE(snapshot.configurations.size() == util::metrics::max_configurations);
+	REQUIRE(snapshot.configurations.back().other);
+	REQUIRE(snapshot.configurations.back().num_games == num_configurations - (util::metrics::max_configurations - 1));
+
+	util::metrics::clear();
+}
+
+TEST_CASE("Metrics export", "[Metrics]") {
+	util::metrics::clear();
+	util::metrics::record(Histogram::MoveSolveTime, 2'000'000);
+	util::metrics::record_game({ 16, 16, 40 }, true, 2);
+	util::metrics::Snapshot const snapshot = util::metrics::snapshot();
+	util::metrics::clear();
+
+	std::ostringstream json;
+	util::metrics::write_json(json, snapshot);
+	REQUIRE(json.str().find("\"move_solve_time_ns\":{\"count\":1,\"sum\":2000000") != std::string::npos);
+	REQUIRE(json.str().find("{\"width\":16,\"height\":16,\"mines\":40,\"games\":1,\"won\":1,\"win_rate\":1}") != std::string::npos);
+
+	std::ostringstream prometheus;
+	util::metrics::write_prometheus(prometheus, snapshot);
+	REQUIRE(prometheus.str().find("# TYPE winmine_move_solve_seconds summary\n") != std::string::npos);
+	REQUIRE(prometheus.str().find("winmine_move_solve_seconds_sum 0.002\n") != std::string::npos);
+	REQUIRE(prometheus.str().find("winmine_games_won_total{board=\"16x16\",mines=\"40\"} 1\n") != std::string::npos);
+}
@@ -0,0 +1,73 @@
+#include "catch.hpp"
+
+#include "neighbour_count.h"
+#include "topology.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using util::Pos;
+
+// One neighbour at a time, the obvious way
+std::vector<std::uint8_t> count_neighbours_reference(std::vector<std::uint8_t> const& plane, int width, int height) {
+	std::vector<std::uint8_t> counts(plane.size());
+	for (int i = 0; i < width * height; ++i) {
+		for (Pos p : util::get_adjacent_positions({ i % width, i / width }, width, height)) {
+			counts[i] += plane[p.y * width + p.x];
+		}
+	}
+	return counts;
+}
+
+TEST_CASE("Whole board neighbour count", "[NeighbourCount]") {
+	std::mt19937 rng{ 99 };
+	util::SimdLevel const levels[] = { util::SimdLevel::Scalar, util::SimdLevel::SSE2, util::SimdLevel::AVX2 };
+
+	// Sizes around the vector widths, so both the vector loops and the tails are covered
+	for (int width : { 1, 2, 3, 9, 16, 17, 18, 30, 33, 34, 35, 66, 100 }) {
+		for (int height : { 1, 2, 3, 16 }) {
+			std::vector<std::uint8_t> plane(width * height);
+			for (std::uint8_t& cell : plane) {
+				cell = rng() % 3 == 0;
+			}
+			std::vector<std::uint8_t> const expected = count_neighbours_reference(plane, width, height);
+
+			for (util::SimdLevel level : levels) {
+				std::vector<std::uint8_t> actual(plane.size(), 0xff);
+				util::count_neighbours(plane.data(), width, height, actual.data(), level);
+
+				CAPTURE(width, height, static_cast<int>(level));
+				REQUIRE(actual == expected);
+			}
+		}
+	}
+}
+
+TEST_CASE("Compile time neighbour table", "[NeighbourCount]") {
+	using Topology = util::FixedTopology<9, 7>;
+	std::mt19937 rng{ 5 };
+
+	for (int i = 0; i < Topology::num_cells(); ++i) {
+		std::vector<int> expected;
+		for (Pos p : util::get_adjacent_positions({ i % 9, i / 9 }, 9, 7)) {
+			expected.push_back(p.y * 9 + p.x);
+		}
+		std::vector<int> neighbours;
+		Topology::for_each_neighbour(i, [&](int n) { neighbours.push_back(n); });
+		std::sort(expected.begin(), expected.end());
+		std::sort(neighbours.begin(), neighbours.end());
+		REQUIRE(neighbours == expected);
+	}
+
+	std::vector<std::uint8_t> plane(Topology::num_cells() + 1);
+	for (int i = 0; i < Topology::num_cells(); ++i) {
+		plane[i] = rng() % 2;
+	}
+	std::vector<std::uint8_t> counts(Topology::num_cells());
+	Topology::count_neighbours(plane.data(), counts.data());
+	plane.pop_back();
+	REQUIRE(counts == count_neighbours_reference(plane, 9, 7));
+}
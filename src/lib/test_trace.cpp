@@ -0,0 +1,50 @@
+#include "catch.hpp"
+
+#include "trace.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+int count_occurrences(std::string const& text, std::string const& word) {
+	int count = 0;
+	for (std::size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + 1)) {
+		++count;
+	}
+	return count;
+}
+
+} // end anonymous namespace
+
+// Scopes are used directly, so this runs whether or not TRACE_SCOPE is compiled in
+TEST_CASE("Trace events from several threads", "[Trace]") {
+	util::trace::clear();
+
+	{
+		util::trace::Scope outer{ "outer" };
+		util::trace::Scope inner{ "inner" };
+	}
+	std::thread worker{ []() {
+		util::trace::set_thread_name("worker \"1\"");
+		util::trace::Scope scope{ "on worker" };
+		} };
+	worker.join();
+
+	REQUIRE(util::trace::num_events() == 3);
+	REQUIRE(util::trace::num_dropped_events() == 0);
+
+	std::ostringstream json;
+	util::trace::write_chrome_trace(json);
+	std::string const text = json.str();
+	REQUIRE(text.rfind("{\"traceEvents\":[", 0) == 0);
+	REQUIRE(count_occurrences(text, "\"ph\":\"X\"") == 3);
+	REQUIRE(count_occurrences(text, "\"name\":\"inner\"") == 1);
+	REQUIRE(count_occurrences(text, "\"name\":\"on worker\"") == 1);
+	REQUIRE(count_occurrences(text, "\"name\":\"worker \\\"1\\\"\"") == 1); // escaped in the thread name metadata
+
+	// Nothing left to write at exit
+	util::trace::clear();
+	REQUIRE(util::trace::num_events() == 0);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "neighbour_count.h"
+#include "util.h"
+
+namespace util {
+
+/*
+* Neighbourhoods of a board whose size is only known at runtime.
+* Cells are numbered index = y*width + x. Same interface as FixedTopology.
+*/
+struct DynamicTopology {
+    int width;
+    int height;
+
+    int num_cells() const { return width * height; }
+
+    template<typename F>
+    void for_each_neighbour(int index, F&& f) const {
+        for_each_adjacent_position(Pos{ index % width, index / width }, width, height, [&f, this](Pos p) {
+            f(p.y * width + p.x);
+            });
+    }
+
+    // out[i] = number of set neighbours of cell i. plane has num_cells() + 1 bytes, the last one 0.
+    void count_neighbours(std::uint8_t const* plane, std::uint8_t* out) const {
+        util::count_neighbours(plane, width, height, out);
+    }
+};
+
+/*
+* Neighbourhoods of a board with a compile time size, from a table built at compile time.
+* Every cell has exactly 8 table entries. Neighbours missing because of a wall point at index num_cells(), a
+* padding cell one past the board, so all loops over neighbours have a fixed trip count and are fully unrolled.
+*/
+template<int Width, int Height>
+struct FixedTopology {
+    static constexpr int width = Width;
+    static constexpr int height = Height;
+    static constexpr int padding = Width * Height;
+
+    using NeighbourTable = std::array<std::array<std::uint16_t, 8>, Width * Height>;
+
+    static constexpr NeighbourTable make_neighbour_table() {
+        NeighbourTable table{};
+        for (int y = 0; y < Height; ++y) {
+            for (int x = 0; x < Width; ++x) {
+                int n = 0;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        if (dx == 0 && dy == 0) {
+                            continue;
+                        }
+                        bool const inside = x + dx >= 0 && x + dx < Width && y + dy >= 0 && y + dy < Height;
+                        table[y * Width + x][n++] = static_cast<std::uint16_t>(inside ? (y + dy) * Width + x + dx : padding);
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    static constexpr NeighbourTable neighbours = make_neighbour_table();
+
+    static constexpr int num_cells() { return Width * Height; }
+
+    template<typename F>
+    static void for_each_neighbour(int index, F&& f) {
+        for_each_neighbour(index, f, std::make_index_sequence<8>{});
+    }
+
+    // out[i] = number of set neighbours of cell i. plane has num_cells() + 1 bytes, the last one 0.
+    static void count_neighbours(std::uint8_t const* plane, std::uint8_t* out) {
+        for (int i = 0; i < Width * Height; ++i) {
+            out[i] = sum_neighbours(plane, i, std::make_index_sequence<8>{});
+        }
+    }
+
+private:
+    template<typename F, std::size_t... N>
+    static void for_each_neighbour(int index, F& f, std::index_sequence<N...>) {
+        auto const& cell_neighbours = neighbours[index];
+        ((cell_neighbours[N] != padding ? static_cast<void>(f(static_cast<int>(cell_neighbours[N]))) : void()), ...);
+    }
+
+    template<std::size_t... N>
+    static std::uint8_t sum_neighbours(std::uint8_t const* plane, int index, std::index_sequence<N...>) {
+        auto const& cell_neighbours = neighbours[index];
+        return static_cast<std::uint8_t>((plane[cell_neighbours[N]] + ...));
+    }
+};
+
+} // namespace util
@@ -0,0 +1,165 @@
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util::trace {
+
+namespace {
+
+struct Event {
+    char const* name;
+    std::int64_t start_ns; // since the epoch of the trace
+    std::int64_t duration_ns;
+};
+
+struct ThreadBuffer {
+    int thread_id = 0;
+    std::string name;
+    std::vector<Event> events;
+    std::size_t num_dropped = 0;
+};
+
+void write_json_string(std::ostream& os, std::string const& text) {
+    os << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            os << '\\';
+        }
+        os << c;
+    }
+    os << '"';
+}
+
+/*
+* All thread buffers, kept alive after their threads are gone so their events still make it into the trace.
+* The lock is only taken when a thread records its first event, and when the trace is written.
+*/
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    Clock::time_point const epoch = Clock::now();
+
+    // Anything recorded is written out at exit, by then the other threads have been joined
+    ~Registry() {
+        if (num_events() > 0 && write_chrome_trace("trace.json")) {
+            std::cout << "Wrote " << num_events() << " trace events to trace.json\n";
+        }
+    }
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& this_thread_buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> const buffer = []() {
+        Registry& reg = registry();
+        auto buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock{ reg.mutex };
+        buffer->thread_id = static_cast<int>(reg.buffers.size()) + 1;
+        reg.buffers.push_back(buffer);
+        return buffer;
+    }();
+    return *buffer;
+}
+
+} // end anonymous namespace
+
+void record(char const* name, Clock::time_point start, Clock::time_point end) {
+    ThreadBuffer& buffer = this_thread_buffer();
+    if (buffer.events.size() >= max_events_per_thread) {
+        ++buffer.num_dropped;
+        return;
+    }
+    Clock::time_point const epoch = registry().epoch;
+    buffer.events.push_back({
+        name,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() });
+}
+
+void set_thread_name(std::string name) {
+    this_thread_buffer().name = std::move(name);
+}
+
+/*
+* Complete ("X") events with microsecond timestamps, plus a metadata event naming each thread that has a name.
+* All events belong to process 1, threads are numbered in the order they first recorded something.
+*/
+void write_chrome_trace(std::ostream& os) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock{ reg.mutex };
+
+    os << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto separate = [&]() {
+        if (!first) {
+            os << ",\n";
+        }
+        first = false;
+    };
+
+    for (std::shared_ptr<ThreadBuffer> const& buffer : reg.buffers) {
+        if (!buffer->name.empty()) {
+            separate();
+            os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id << ",\"args\":{\"name\":";
+            write_json_string(os, buffer->name);
+            os << "}}";
+        }
+        for (Event const& event : buffer->events) {
+            separate();
+            os << "{\"name\":";
+            write_json_string(os, event.name);
+            os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                << ",\"ts\":" << event.start_ns / 1000.
+                << ",\"dur\":" << event.duration_ns / 1000. << '}';
+        }
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool write_chrome_trace(std::string const& path) {
+    std::ofstream file{ path };
+    if (!file) {
+        std::cout << "Could not open " << path << " to write the trace\n";
+        return false;
+    }
+    write_chrome_trace(file);
+    return static_cast<bool>(file);
+}
+
+std::size_t num_events() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock{ reg.mutex };
+    std::size_t total = 0;
+    for (std::shared_ptr<ThreadBuffer> const& buffer : reg.buffers) {
+        total += buffer->events.size();
+    }
+    return total;
+}
+
+std::size_t num_dropped_events() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock{ reg.mutex };
+    std::size_t total = 0;
+    for (std::shared_ptr<ThreadBuffer> const& buffer : reg.buffers) {
+        total += buffer->num_dropped;
+    }
+    return total;
+}
+
+void clear() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock{ reg.mutex };
+    for (std::shared_ptr<ThreadBuffer> const& buffer : reg.buffers) {
+        buffer->events.clear();
+        buffer->num_dropped = 0;
+    }
+}
+
+} // namespace util::trace
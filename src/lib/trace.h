@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/*
+* Scoped timing events, written out in the Chrome Trace Event format (open the file in chrome://tracing or
+* ui.perfetto.dev). Every thread records into a buffer of its own, so a scope costs two clock reads and a
+* store, and no lock. The events are written to trace.json when the program exits.
+*
+* TRACE_SCOPE only records anything when the WINMINE_TRACE CMake option is on, otherwise it compiles to nothing.
+*/
+
+namespace util::trace {
+
+// Events per thread. Once a thread has recorded this many, it drops the rest and counts them.
+constexpr std::size_t max_events_per_thread = 1 << 20;
+
+using Clock = std::chrono::steady_clock;
+
+// Record one event on the calling thread. name must outlive the trace, a string literal.
+void record(char const* name, Clock::time_point start, Clock::time_point end);
+
+// Name the calling thread in the trace
+void set_thread_name(std::string name);
+
+// Write every event recorded so far, from all threads, as Chrome Trace Event JSON
+void write_chrome_trace(std::ostream& os);
+
+// Same as above, to a file. Returns false when the file can't be written.
+bool write_chrome_trace(std::string const& path);
+
+// Number of events recorded, and dropped because a buffer was full, over all threads
+std::size_t num_events();
+std::size_t num_dropped_events();
+
+// Forget all events, on all threads. No other thread may be recording at the same time.
+void clear();
+
+// Records the time from construction to destruction
+class Scope {
+    char const* name;
+    Clock::time_point start;
+
+public:
+    explicit Scope(char const* name)
+        : name{ name }
+        , start{ Clock::now() }
+    {}
+    Scope(Scope&) = delete;
+
+    ~Scope() {
+        record(name, start, Clock::now());
+    }
+};
+
+} // namespace util::trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef WINMINE_TRACE
+#define TRACE_SCOPE(name) ::util::trace::Scope TRACE_CONCAT(trace_scope_, __LINE__){ name }
+#define TRACE_THREAD_NAME(name) ::util::trace::set_thread_name(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
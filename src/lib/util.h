@@ -28,4 +28,25 @@ struct GameSettings {
 // Returns up to 8 adjacent positions. Less if the input position is next to a wall.
 std::vector<Pos> get_adjacent_positions(Pos pos, int max_width, int max_height);
 
+// Calls f for each of the up to 8 adjacent positions, same order as get_adjacent_positions.
+// Does not allocate, use this in hot loops.
+template<typename F>
+void for_each_adjacent_position(Pos pos, int max_width, int max_height, F&& f) {
+    int const x = pos.x;
+    int const y = pos.y;
+
+    if (y - 1 >= 0) {
+        if (x - 1 >= 0) f(Pos{ x - 1, y - 1 });
+        f(Pos{ x, y - 1 });
+        if (x + 1 < max_width) f(Pos{ x + 1, y - 1 });
+    }
+    if (x - 1 >= 0) f(Pos{ x - 1, y });
+    if (x + 1 < max_width) f(Pos{ x + 1, y });
+    if (y + 1 < max_height) {
+        if (x - 1 >= 0) f(Pos{ x - 1, y + 1 });
+        f(Pos{ x, y + 1 });
+        if (x + 1 < max_width) f(Pos{ x + 1, y + 1 });
+    }
+}
+
 } // namespace util
\ No newline at end of file
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "minefield.h"
+#include "../lib/metrics.h"
+#include "../lib/topology.h"
+#include "../lib/trace.h"
+#include "../lib/util.h"
+
+/*
+* Minefield with the board size fixed at compile time, for the classic sizes that almost all games use.
+* Cells live in a std::array, and neighbour loops go through the compile time table of util::FixedTopology,
+* fully unrolled. Plays exactly like Minefield: the same seed and clicks give the same game.
+* Meant for headless play and the solver, it has no change log and no copy-on-write sharing.
+*/
+template<int Width, int Height>
+class FixedMinefield {
+public:
+    using Topology = util::FixedTopology<Width, Height>;
+
+private:
+    static constexpr int num_cells = Width * Height;
+
+    std::array<Cell, num_cells> field{};
+    int num_bombs = 0;
+    int num_exposed = 0;
+    GameState state = GameState::Uninitialized;
+    unsigned seed = 0;
+
+    void initialize_num_adjacent_bombs() {
+        std::array<std::uint8_t, num_cells + 1> bomb_plane{}; // last one is the padding cell
+        for (int i = 0; i < num_cells; ++i) {
+            bomb_plane[i] = field[i].is_bomb();
+        }
+        std::array<std::uint8_t, num_cells> counts;
+        Topology::count_neighbours(bomb_plane.data(), counts.data());
+        for (int i = 0; i < num_cells; ++i) {
+            field[i].set_num_adjacent_bombs(counts[i]);
+        }
+    }
+
+    void show_all_bombs() {
+        for (Cell& cell : field) {
+            if (cell.is_bomb() && !cell.is_exposed()) {
+                cell.expose();
+                ++num_exposed;
+            }
+        }
+    }
+
+public:
+    FixedMinefield(int num_bombs, unsigned seed)
+        : num_bombs{ num_bombs }
+        , seed{ seed }
+    {}
+
+    FixedMinefield(std::vector<util::Pos> const& mine_locations)
+        : num_bombs{ static_cast<int>(mine_locations.size()) }
+        , state{ GameState::Playing }
+    {
+        for (util::Pos const& pos : mine_locations) {
+            field[pos.y * Width + pos.x].make_bomb();
+        }
+        initialize_num_adjacent_bombs();
+    }
+
+    static constexpr int get_width() { return Width; }
+    static constexpr int get_height() { return Height; }
+    int get_num_mines() const { return num_bombs; }
+    Cell const& get_cell(util::Pos const& pos) const { return field[pos.y * Width + pos.x]; }
+
+    bool is_game_lost() const { return state == GameState::Lost; }
+    bool is_game_won() const { return state == GameState::Won; }
+    GameState get_state() const { return state; }
+
+    int count_exposed_cells() const { return num_exposed; }
+
+    void expose(util::Pos pos) {
+        expose_many({ pos });
+    }
+
+    // Same rules as Minefield::expose_many, with the flood fill on a fixed size stack
+    void expose_many(std::vector<util::Pos> const& positions) {
+        if (positions.empty()) {
+            return;
+        }
+
+        if (state == GameState::Uninitialized) {
+            int const clicked = positions.front().y * Width + positions.front().x;
+            for (int index : random_mine_indices(num_cells, clicked, num_bombs, seed)) {
+                field[index].make_bomb();
+            }
+            initialize_num_adjacent_bombs();
+            state = GameState::Playing;
+        }
+
+        TRACE_SCOPE("flood fill");
+
+        // Cells are exposed when they are pushed, so the stack only ever holds each zero once
+        std::array<std::uint16_t, num_cells> zeros;
+        int num_zeros = 0;
+        int num_opened = 0;
+        auto open = [this, &zeros, &num_zeros, &num_opened](int index) {
+            field[index].expose();
+            ++num_exposed;
+            ++num_opened;
+            if (field[index].get_num_adjacent_bombs() == 0) {
+                zeros[num_zeros++] = static_cast<std::uint16_t>(index);
+            }
+        };
+
+        for (util::Pos const& pos : positions) {
+            int const index = pos.y * Width + pos.x;
+            if (field[index].is_bomb()) {
+                state = GameState::Lost;
+                show_all_bombs();
+                return;
+            }
+            if (field[index].is_covered()) {
+                open(index);
+            }
+        }
+        while (num_zeros > 0) {
+            Topology::for_each_neighbour(zeros[--num_zeros], [this, &open](int neighbour) {
+                if (field[neighbour].is_covered()) {
+                    open(neighbour);
+                }
+                });
+        }
+        util::metrics::record(util::metrics::Histogram::FloodFillSize, num_opened);
+
+        if (state == GameState::Playing && num_exposed == num_cells - num_bombs) {
+            state = GameState::Won;
+        }
+    }
+
+    void chord(util::Pos pos) {
+        int const index = pos.y * Width + pos.x;
+        if (!field[index].is_exposed() || field[index].get_num_adjacent_bombs() == 0) {
+            return;
+        }
+
+        int num_flags = 0;
+        std::vector<util::Pos> unflagged;
+        Topology::for_each_neighbour(index, [this, &num_flags, &unflagged](int neighbour) {
+            num_flags += field[neighbour].is_flagged();
+            if (field[neighbour].state == CellState::Covered) {
+                unflagged.emplace_back(neighbour % Width, neighbour / Width);
+            }
+            });
+
+        if (num_flags == field[index].get_num_adjacent_bombs()) {
+            expose_many(unflagged);
+        }
+    }
+
+    void toggle_flagged(util::Pos pos) {
+        Cell& cell = field[pos.y * Width + pos.x];
+        if (cell.is_covered()) {
+            cell.toggle_flagged();
+        }
+    }
+
+    void make_flagged(util::Pos pos) {
+        Cell& cell = field[pos.y * Width + pos.x];
+        if (cell.state == CellState::Covered) {
+            cell.state = CellState::Flagged;
+        }
+    }
+};
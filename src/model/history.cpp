@@ -0,0 +1,40 @@
+#include "history.h"
+
+#include "minefield.h"
+
+History::History(std::size_t capacity)
+    : capacity{ capacity }
+{}
+
+void History::record(Minefield const& state) {
+    if (undo_states.size() == capacity) {
+        undo_states.pop_front();
+    }
+    undo_states.push_back(state);
+    redo_states.clear();
+}
+
+std::optional<Minefield> History::undo(Minefield const& current) {
+    if (undo_states.empty()) {
+        return {};
+    }
+    std::optional<Minefield> previous{ std::move(undo_states.back()) };
+    undo_states.pop_back();
+    redo_states.push_back(current);
+    return previous;
+}
+
+std::optional<Minefield> History::redo(Minefield const& current) {
+    if (redo_states.empty()) {
+        return {};
+    }
+    std::optional<Minefield> next{ std::move(redo_states.back()) };
+    redo_states.pop_back();
+    undo_states.push_back(current);
+    return next;
+}
+
+void History::clear() {
+    undo_states.clear();
+    redo_states.clear();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "minefield.h"
+
+/*
+* Bounded undo/redo history of minefield states.
+* Minefield copies share their cells, so each stored state only costs the tiles that changed after it.
+*/
+class History {
+    std::deque<Minefield> undo_states; // oldest first
+    std::vector<Minefield> redo_states; // most recently undone last
+    std::size_t capacity;
+
+public:
+    explicit History(std::size_t capacity = 200);
+
+    // Call before changing the minefield. Forgets the oldest state when full, and everything that could be redone.
+    void record(Minefield const& state);
+
+    // The state before the last change, or nothing if there is none. current becomes redoable.
+    std::optional<Minefield> undo(Minefield const& current);
+    // The state undone last, or nothing if there is none. current becomes undoable again.
+    std::optional<Minefield> redo(Minefield const& current);
+
+    void clear();
+
+    bool can_undo() const { return !undo_states.empty(); }
+    bool can_redo() const { return !redo_states.empty(); }
+};
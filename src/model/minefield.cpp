@@ -1,10 +1,18 @@
 #include "Minefield.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <numeric>
 #include <array>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <vector>
 
+#include "../lib/metrics.h"
+#include "../lib/neighbour_count.h"
+#include "../lib/trace.h"
 #include "../lib/util.h"
 
 using util::Pos;
@@ -15,53 +23,89 @@ void remove_erase(std::vector<int>& vec, int elem) {
     vec.erase(std::remove(vec.begin(), vec.end(), elem), vec.end());
 }
 
-void show_all_bombs(std::vector<Cell>& cells) {
-    for (Cell& c : cells) {
-        if (c.is_bomb()) {
-            c.expose();
-        }
+} // end anonymous namespace
+
+CellStore::CellStore(int num_cells)
+    : tiles{ std::make_shared<TileTable>() }
+    , num_cells{ num_cells }
+{
+    for (int i = 0; i < num_cells; i += tile_size) {
+        tiles->push_back(std::make_shared<Tile>());
     }
 }
 
-} // end anonymous namespace
+Cell& CellStore::edit(int index) {
+    if (tiles.use_count() > 1) {
+        tiles = std::make_shared<TileTable>(*tiles);
+    }
+    std::shared_ptr<Tile>& tile = (*tiles)[index / tile_size];
+    if (tile.use_count() > 1) {
+        tile = std::make_shared<Tile>(*tile);
+    }
+    // A copy on another thread may have just let go of this tile, its reads must be done before we write
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (*tile)[index % tile_size];
+}
 
-void Minefield::random_place_bombs(Pos clicked_pos) {
-    int clicked_index = clicked_pos.y * width + clicked_pos.x;
+std::vector<int> random_mine_indices(int num_cells, int clicked_index, int num_bombs, unsigned seed) {
+    std::mt19937 rng{ seed };
 
     std::vector<int> available_indices;
-    available_indices.resize(field.size());
+    available_indices.resize(num_cells);
     std::iota(available_indices.begin(), available_indices.end(), 0);
     remove_erase(available_indices, clicked_index);
 
+    std::vector<int> mine_indices;
     for (int i = 0; i < num_bombs; ++i) {
-        int mine_index = rand() % available_indices.size();
-        field[available_indices[mine_index]].make_bomb();
+        int mine_index = rng() % available_indices.size();
+        mine_indices.push_back(available_indices[mine_index]);
         remove_erase(available_indices, available_indices[mine_index]);
     }
+    return mine_indices;
 }
 
-int Minefield::count_adjacent_bombs(int index) {
-    Pos const pos{ index % width, index / width };
+void Minefield::show_all_bombs() {
+    for (int i = 0; i < field.size(); ++i) {
+        if (field[i].is_bomb() && !field[i].is_exposed()) {
+            change_cell(i, [](Cell& cell) { cell.expose(); });
+        }
+    }
+}
 
-    std::vector<Pos> adjacent_positions = util::get_adjacent_positions(pos, width, height);
+void Minefield::random_place_bombs(Pos clicked_pos) {
+    int clicked_index = clicked_pos.y * width + clicked_pos.x;
 
-    return std::count_if(adjacent_positions.begin(), adjacent_positions.end(), [this](Pos p) {
-        return get_cell(p).is_bomb();
-        });
+    for (int index : random_mine_indices(field.size(), clicked_index, num_bombs, seed)) {
+        field.edit(index).make_bomb();
+    }
 }
 
 void Minefield::initialize_num_adjacent_bombs() {
+    std::vector<std::uint8_t> bomb_plane(field.size());
+    for (int i = 0; i < field.size(); ++i) {
+        bomb_plane[i] = field[i].is_bomb();
+    }
+
+    std::vector<std::uint8_t> counts(field.size());
+    util::count_neighbours(bomb_plane.data(), width, height, counts.data());
+
     for (int i = 0; i < field.size(); ++i) {
-        field[i].set_num_adjacent_bombs(count_adjacent_bombs(i));
+        field.edit(i).set_num_adjacent_bombs(counts[i]);
     }
 }
 
 Minefield::Minefield(util::GameSettings game_settings)
+    : Minefield{ game_settings, static_cast<unsigned>(rand()) }
+{}
+
+Minefield::Minefield(util::GameSettings game_settings, unsigned seed)
     : width{ game_settings.width }
     , height{ game_settings.height }
     , num_bombs{ game_settings.num_bombs }
-    , state{ GameState::Uninitialized }
     , field{ width * height }
+    , state{ GameState::Uninitialized }
+    , seed{ seed }
+    , hash{ zobrist::board_key(width, height, num_bombs) }
 {}
 
 Minefield::Minefield(int width, int height, std::vector<Pos> const& mine_locations)
@@ -70,23 +114,14 @@ Minefield::Minefield(int width, int height, std::vector<Pos> const& mine_locatio
     , num_bombs{ static_cast<int>(mine_locations.size()) }
     , state{ GameState::Playing }
     , field{ width * height }
+    , hash{ zobrist::board_key(width, height, num_bombs) }
 {
     for (Pos const& pos : mine_locations) {
-        field[pos.y * width + pos.x].make_bomb();
+        field.edit(pos.y * width + pos.x).make_bomb();
     }
     initialize_num_adjacent_bombs();
 }
 
-Minefield& Minefield::operator=(Minefield& rhs) {
-    using std::swap;
-    swap(*this, rhs);
-    return *this;
-}
-
-Cell& Minefield::get_cell(Pos const& pos) {
-    return field[pos.y * width + pos.x];
-}
-
 Cell const& Minefield::get_cell(Pos const& pos) const {
     return field[pos.y * width + pos.x];
 }
@@ -96,55 +131,120 @@ bool Minefield::check_win_condition() {
 }
 
 void Minefield::expose(Pos pos) {
+    expose_many({ pos });
+}
+
+void Minefield::expose_many(std::vector<Pos> const& positions) {
+    if (positions.empty()) {
+        return;
+    }
+    ++version;
 
     if (state == GameState::Uninitialized) {
-        random_place_bombs(pos);
+        random_place_bombs(positions.front());
         initialize_num_adjacent_bombs();
         state = GameState::Playing;
     }
 
-    Cell& cell = get_cell(pos);
-    if (cell.is_bomb()) {
-        std::cout << "you lost\n";
-        state = GameState::Lost;
-        show_all_bombs(field);
-    }
-    else if (cell.is_covered()) {
-        cell.expose();
-        if (cell.get_num_adjacent_bombs() == 0) {
-            for (Pos const& pos : util::get_adjacent_positions(pos, width, height)) {
-                expose(pos);
-            }
+    TRACE_SCOPE("flood fill");
+
+    // Cells are exposed as they are found, zeros are kept to expose their neighbours later
+    std::vector<int> zeros;
+    int num_opened = 0;
+    auto open = [&](Pos pos) {
+        int const index = pos.y * width + pos.x;
+        change_cell(index, [](Cell& cell) { cell.expose(); });
+        ++num_opened;
+        if (field[index].get_num_adjacent_bombs() == 0) {
+            zeros.push_back(index);
         }
+    };
 
-        if (state == GameState::Playing && check_win_condition()) {
-            state = GameState::Won;
-            std::cout << "You have won!\n";
+    for (Pos const& pos : positions) {
+        if (get_cell(pos).is_bomb()) {
+            std::cout << "you lost\n";
+            state = GameState::Lost;
+            show_all_bombs();
+            return;
         }
+        if (get_cell(pos).is_covered()) {
+            open(pos);
+        }
+    }
+
+    while (!zeros.empty()) {
+        int const index = zeros.back();
+        zeros.pop_back();
+        util::for_each_adjacent_position({ index % width, index / width }, width, height, [&](Pos p) {
+            if (get_cell(p).is_covered()) {
+                open(p);
+            }
+            });
+    }
+    util::metrics::record(util::metrics::Histogram::FloodFillSize, num_opened);
+
+    if (state == GameState::Playing && check_win_condition()) {
+        state = GameState::Won;
+        std::cout << "You have won!\n";
     }
 }
 
-int Minefield::count_exposed_cells() {
-    return std::count_if(field.begin(), field.end(), [](Cell const& cell) {
-        return cell.is_exposed();
+void Minefield::chord(Pos pos) {
+    Cell const& cell = get_cell(pos);
+    if (!cell.is_exposed() || cell.get_num_adjacent_bombs() == 0) {
+        return;
+    }
+
+    int num_flags = 0;
+    std::vector<Pos> unflagged;
+    util::for_each_adjacent_position(pos, width, height, [&](Pos p) {
+        Cell const& neighbour = get_cell(p);
+        num_flags += neighbour.is_flagged();
+        if (neighbour.state == CellState::Covered) {
+            unflagged.push_back(p);
+        }
         });
+
+    if (num_flags == cell.get_num_adjacent_bombs()) {
+        expose_many(unflagged);
+    }
+}
+
+int Minefield::count_exposed_cells() const {
+    int num_exposed = 0;
+    for (int i = 0; i < field.size(); ++i) {
+        num_exposed += field[i].is_exposed();
+    }
+    return num_exposed;
 }
 
 void Minefield::toggle_flagged(Pos pos) {
-    field[pos.y * width + pos.x].toggle_flagged();
+    if (get_cell(pos).is_covered()) {
+        change_cell(pos.y * width + pos.x, [](Cell& cell) { cell.toggle_flagged(); });
+    }
 }
 void Minefield::make_flagged(Pos pos) {
     if (get_cell(pos).state == CellState::Covered) {
-        get_cell(pos).state = CellState::Flagged;
+        change_cell(pos.y * width + pos.x, [](Cell& cell) { cell.state = CellState::Flagged; });
+    }
+}
+
+std::vector<Pos> Minefield::take_changed_cells() {
+    std::vector<Pos> changed;
+    changed.reserve(changed_cells.size());
+    for (int index : changed_cells) {
+        changed.emplace_back(index % width, index / width);
     }
+    changed_cells.clear();
+    return changed;
 }
 
 CellIter Minefield::begin() const {
-    return CellIter(field.begin(), width);
+    return CellIter(field, 0, width);
 }
 
 CellIter Minefield::end() const {
-    return CellIter(field.end(), width);
+    return CellIter(field, field.size(), width);
 }
 
 void swap(Minefield& lhs, Minefield& rhs) {
@@ -154,4 +254,8 @@ void swap(Minefield& lhs, Minefield& rhs) {
     swap(lhs.field, rhs.field);
     swap(lhs.state, rhs.state);
     swap(lhs.num_bombs, rhs.num_bombs);
+    swap(lhs.changed_cells, rhs.changed_cells);
+    swap(lhs.seed, rhs.seed);
+    swap(lhs.version, rhs.version);
+    swap(lhs.hash, rhs.hash);
 }
@@ -2,7 +2,10 @@
 
 #include <numeric>
 #include <array>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <tuple>
 #include <vector>
 
 #include "../lib/util.h"
@@ -41,30 +44,55 @@ public:
 };
 
 
+/*
+* The cells of a minefield, split into fixed size tiles that are shared between copies.
+* Copying a CellStore is O(1). Changing a cell first copies its tile if another copy still uses it, so a change
+* costs O(changed tiles), and the other copies keep seeing the old state. Copies can be read from other threads.
+*/
+class CellStore {
+    static constexpr int tile_size = 256;
+    using Tile = std::array<Cell, tile_size>;
+    using TileTable = std::vector<std::shared_ptr<Tile>>;
+
+    std::shared_ptr<TileTable> tiles;
+    int num_cells = 0;
+
+public:
+    explicit CellStore(int num_cells);
+
+    int size() const { return num_cells; }
+
+    Cell const& operator[](int index) const {
+        return (*(*tiles)[index / tile_size])[index % tile_size];
+    }
+
+    // Cell that may be changed, unshares the tile first
+    Cell& edit(int index);
+};
+
 // Allows iterating over a minefield with a for-each loop
 class CellIter {
-    std::vector<Cell>::const_iterator cell_iter;
+    CellStore const* cells;
     int const width;
-    int inc_count = 0;
+    int index = 0;
 
 public:
-    CellIter(std::vector<Cell>::const_iterator iter, int width)
-        : cell_iter{ iter }
+    CellIter(CellStore const& cells, int index, int width)
+        : cells{ &cells }
         , width{ width }
-        , inc_count{ 0 }
+        , index{ index }
     {}
 
     bool operator!=(CellIter const& rhs) {
-        return cell_iter != rhs.cell_iter;
+        return index != rhs.index;
     }
 
     std::tuple<util::Pos, Cell> operator*() {
-        return { {inc_count % width, inc_count / width}, *cell_iter };
+        return { {index % width, index / width}, (*cells)[index] };
     }
 
     void operator++() {
-        ++cell_iter;
-        ++inc_count;
+        ++index;
     }
 };
 
@@ -75,29 +103,91 @@ enum class GameState {
     , Won
 };
 
+/*
+* Zobrist hashing of what a player can see of a board. Every cell that isn't plain covered adds the key for its
+* look to an XOR, so a change to one cell is two XORs. The keys come from a mixing function rather than a random
+* table, they work for any board size and are the same in every run, so hashes can be stored.
+*/
+namespace zobrist {
+
+// What a player sees of a cell: 0 covered, 1 flagged, 2 + the number when exposed, 11 an exposed bomb
+inline int look_of(Cell const& cell) {
+    if (cell.is_exposed()) {
+        return cell.is_bomb() ? 11 : 2 + cell.get_num_adjacent_bombs();
+    }
+    return cell.is_flagged() ? 1 : 0;
+}
+
+// splitmix64 finalizer
+inline std::uint64_t mix(std::uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// Key for the cell at index showing look, 0 for a covered cell
+inline std::uint64_t cell_key(int index, int look) {
+    return look == 0 ? 0 : mix((static_cast<std::uint64_t>(index) << 4 | look) + 0x9e3779b97f4a7c15);
+}
+
+// Hash of a board with every cell covered, so boards of different sizes or mine counts differ
+inline std::uint64_t board_key(int width, int height, int num_bombs) {
+    return mix(~(static_cast<std::uint64_t>(width) << 40 | static_cast<std::uint64_t>(height) << 20 | num_bombs));
+}
+
+// The same hash Minefield keeps up to date, computed from scratch in O(cells). Board is Minefield or a FixedMinefield.
+template<typename Board>
+std::uint64_t hash_of(Board const& board) {
+    std::uint64_t hash = board_key(board.get_width(), board.get_height(), board.get_num_mines());
+    for (int y = 0; y < board.get_height(); ++y) {
+        for (int x = 0; x < board.get_width(); ++x) {
+            hash ^= cell_key(y * board.get_width() + x, look_of(board.get_cell({ x, y })));
+        }
+    }
+    return hash;
+}
+
+} // namespace zobrist
+
+// The bomb positions for a game: num_bombs random cells, never the first clicked one
+std::vector<int> random_mine_indices(int num_cells, int clicked_index, int num_bombs, unsigned seed);
+
+// Copies are cheap snapshots, see CellStore
 class Minefield {
     int width = 0;
     int height = 0;
     int num_bombs = 0;  // Needed because the bomb placement is deferred
-    std::vector<Cell> field; // width*height size, flattened with index = y*width + x
+    CellStore field; // width*height size, flattened with index = y*width + x. Shared with copies until changed
     GameState state = GameState::Uninitialized; // only initialize the bombs after the first click/expose
+    std::vector<int> changed_cells; // indices of cells that were exposed or (un)flagged, see take_changed_cells()
+    unsigned seed = 0; // for the bomb placement
+    std::uint64_t version = 0; // counts the moves that exposed cells, flags are left out as the solver ignores them
+    std::uint64_t hash = 0; // see zobrist, kept up to date by every change to a cell
+
+    // Change a cell, and update the hash for its new look
+    template<typename F>
+    void change_cell(int index, F&& change) {
+        Cell& cell = field.edit(index);
+        hash ^= zobrist::cell_key(index, zobrist::look_of(cell));
+        change(cell);
+        hash ^= zobrist::cell_key(index, zobrist::look_of(cell));
+        changed_cells.push_back(index);
+    }
 
-    void random_place_bombs(util::Pos clicked_pos);
+    void show_all_bombs();
 
-    int count_adjacent_bombs(int index);
+    void random_place_bombs(util::Pos clicked_pos);
 
     void initialize_num_adjacent_bombs();
 
     bool check_win_condition();
 
-    Cell& get_cell(util::Pos const& pos);
-
 public:
     Minefield(util::GameSettings game_settings);
+    // Bombs are placed the same way every time for the same seed and first click
+    Minefield(util::GameSettings game_settings, unsigned seed);
     Minefield(int width, int height, std::vector<util::Pos> const& mine_locations);
 
-    Minefield& operator=(Minefield& rhs);
-
     CellIter begin() const;
     CellIter end() const;
 
@@ -110,11 +200,30 @@ public:
 
     bool is_game_lost() const { return state == GameState::Lost; }
     bool is_game_won() const { return state == GameState::Won; }
+    GameState get_state() const { return state; }
 
     void expose(util::Pos pos);
 
-    int count_exposed_cells();
+    // Expose all positions as a single move, with one flood fill and one check for a win.
+    // Stops at the first bomb, the game is lost then.
+    void expose_many(std::vector<util::Pos> const& positions);
+
+    // Classic chord: on an exposed number with that many flags around it, expose all its unflagged neighbours
+    void chord(util::Pos pos);
+
+    int count_exposed_cells() const;
+
+    // 64 bit hash of the visible state: board size, mine count, and how every cell looks. Constant time, it is
+    // updated as cells change. Equal boards hash equal, however they got there.
+    std::uint64_t get_hash() const { return hash; }
+
+    // Changes whenever cells are exposed. Copies have the same version until one of them changes.
+    std::uint64_t get_version() const { return version; }
 
     void toggle_flagged(util::Pos pos);
     void make_flagged(util::Pos pos);
+
+    // Cells that changed their visible state since the last call, in no particular order.
+    // The same cell can show up more than once.
+    std::vector<util::Pos> take_changed_cells();
 };
\ No newline at end of file
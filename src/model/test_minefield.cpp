@@ -0,0 +1,201 @@
+#include "catch.hpp"
+
+#include "fixed_minefield.h"
+#include "history.h"
+#include "minefield.h"
+#include "../lib/util.h"
+
+#include <random>
+
+using util::Pos;
+
+TEST_CASE("Minefield copies are independent snapshots", "[Minefield]") {
+	// Larger than one tile of cells, bomb far away from the clicks
+	Minefield original{ 40, 20, { Pos{ 39, 19 }, Pos{ 38, 19 } } };
+
+	Minefield const snapshot = original;
+	original.toggle_flagged({ 1, 1 });
+	original.expose({ 0, 0 });
+
+	REQUIRE(snapshot.count_exposed_cells() == 0);
+	REQUIRE(!snapshot.get_cell({ 1, 1 }).is_flagged());
+	REQUIRE(original.count_exposed_cells() > 0);
+	REQUIRE(original.get_cell({ 1, 1 }).is_exposed()); // flood fill exposes flagged cells
+
+	SECTION("Assignment leaves the source alone") {
+		Minefield copy{ 3, 3, {} };
+		copy = snapshot;
+		REQUIRE(copy.get_width() == 40);
+		REQUIRE(snapshot.get_width() == 40);
+
+		copy.toggle_flagged({ 5, 5 });
+		REQUIRE(copy.get_cell({ 5, 5 }).is_flagged());
+		REQUIRE(!snapshot.get_cell({ 5, 5 }).is_flagged());
+	}
+}
+
+TEST_CASE("Undo and redo", "[Minefield]") {
+	Minefield minefield{ 4, 4, { Pos{ 3, 3 } } };
+	History history{ 2 };
+
+	history.record(minefield);
+	minefield.toggle_flagged({ 0, 0 });
+	history.record(minefield);
+	minefield.toggle_flagged({ 1, 0 });
+	history.record(minefield);
+	minefield.toggle_flagged({ 2, 0 });
+
+	// Only the last two states are kept
+	minefield = *history.undo(minefield);
+	REQUIRE(!minefield.get_cell({ 2, 0 }).is_flagged());
+	minefield = *history.undo(minefield);
+	REQUIRE(!minefield.get_cell({ 1, 0 }).is_flagged());
+	REQUIRE(minefield.get_cell({ 0, 0 }).is_flagged());
+	REQUIRE(!history.undo(minefield));
+
+	minefield = *history.redo(minefield);
+	REQUIRE(minefield.get_cell({ 1, 0 }).is_flagged());
+	REQUIRE(!minefield.get_cell({ 2, 0 }).is_flagged());
+
+	// A new change drops what could be redone
+	history.record(minefield);
+	minefield.toggle_flagged({ 3, 0 });
+	REQUIRE(!history.can_redo());
+}
+
+TEST_CASE("Fixed size boards play like Minefield", "[Minefield]") {
+	std::mt19937 rng{ 17 };
+
+	for (unsigned seed = 0; seed < 50; ++seed) {
+		Minefield dynamic{ util::GameSettings{ 9, 9, 10 }, seed };
+		FixedMinefield<9, 9> fixed{ 10, seed };
+
+		while (!dynamic.is_game_lost() && !dynamic.is_game_won()) {
+			Pos const pos{ static_cast<int>(rng() % 9), static_cast<int>(rng() % 9) };
+			dynamic.expose(pos);
+			fixed.expose(pos);
+
+			REQUIRE(fixed.get_state() == dynamic.get_state());
+			REQUIRE(fixed.count_exposed_cells() == dynamic.count_exposed_cells());
+			for (auto const& [p, cell] : dynamic) {
+				REQUIRE(fixed.get_cell(p).is_bomb() == cell.is_bomb());
+				REQUIRE(fixed.get_cell(p).state == cell.state);
+				REQUIRE(fixed.get_cell(p).get_num_adjacent_bombs() == cell.get_num_adjacent_bombs());
+			}
+		}
+	}
+}
+
+TEST_CASE("Exposing many cells at once", "[Minefield]") {
+	std::vector<Pos> const mines{ Pos{ 1, 1 }, Pos{ 4, 0 }, Pos{ 5, 5 } };
+
+	SECTION("Same board as exposing them one by one") {
+		std::vector<Pos> const safe{ Pos{ 0, 0 }, Pos{ 2, 2 }, Pos{ 0, 5 }, Pos{ 3, 0 } };
+		Minefield one_by_one{ 6, 6, mines };
+		Minefield batched{ 6, 6, mines };
+		for (Pos const& pos : safe) {
+			one_by_one.expose(pos);
+		}
+		batched.expose_many(safe);
+
+		REQUIRE(batched.get_state() == one_by_one.get_state());
+		for (auto const& [pos, cell] : one_by_one) {
+			REQUIRE(batched.get_cell(pos).state == cell.state);
+		}
+	}
+
+	SECTION("A bomb loses the game") {
+		Minefield minefield{ 6, 6, mines };
+		minefield.expose_many({ Pos{ 0, 5 }, Pos{ 4, 0 } });
+		REQUIRE(minefield.is_game_lost());
+		REQUIRE(minefield.get_cell({ 5, 5 }).is_exposed());
+	}
+
+	SECTION("The same on a fixed size board") {
+		FixedMinefield<6, 6> fixed{ mines };
+		Minefield dynamic{ 6, 6, mines };
+		std::vector<Pos> const safe{ Pos{ 0, 5 }, Pos{ 3, 0 } };
+		fixed.expose_many(safe);
+		dynamic.expose_many(safe);
+		REQUIRE(fixed.count_exposed_cells() == dynamic.count_exposed_cells());
+	}
+}
+
+TEST_CASE("Chord", "[Minefield]") {
+	// The 1 at (1,1) touches only the bomb at (0,0)
+	Minefield minefield{ 5, 5, { Pos{ 0, 0 }, Pos{ 4, 4 } } };
+	minefield.expose({ 1, 1 });
+	REQUIRE(minefield.count_exposed_cells() == 1);
+
+	SECTION("Not without the flags") {
+		minefield.chord({ 1, 1 });
+		REQUIRE(minefield.count_exposed_cells() == 1);
+	}
+
+	SECTION("Exposes the unflagged neighbours once the number is satisfied") {
+		minefield.toggle_flagged({ 0, 0 });
+		minefield.chord({ 1, 1 });
+		REQUIRE(!minefield.is_game_lost());
+		REQUIRE(minefield.get_cell({ 0, 0 }).is_flagged());
+		REQUIRE(minefield.get_cell({ 2, 2 }).is_exposed());
+		REQUIRE(minefield.count_exposed_cells() > 8);
+	}
+
+	SECTION("A wrong flag loses the game") {
+		minefield.toggle_flagged({ 0, 1 });
+		minefield.chord({ 1, 1 });
+		REQUIRE(minefield.is_game_lost());
+	}
+}
+
+TEST_CASE("Incremental hash", "[Minefield]") {
+	std::mt19937 rng{ 2468 };
+	Minefield minefield{ util::GameSettings{ 16, 16, 40 }, 99 };
+	Minefield const fresh = minefield;
+	REQUIRE(minefield.get_hash() == zobrist::hash_of(minefield));
+
+	// Random safe clicks and flags, then a bomb, the kept hash always equals a full recount
+	for (int move = 0; move < 200 && !minefield.is_game_won(); ++move) {
+		Pos const pos{ static_cast<int>(rng() % 16), static_cast<int>(rng() % 16) };
+		switch (rng() % 3) {
+		case 0:
+			if (!minefield.get_cell(pos).is_bomb()) {
+				minefield.expose(pos);
+			}
+			break;
+		case 1: minefield.toggle_flagged(pos); break;
+		case 2: minefield.make_flagged(pos); break;
+		}
+		REQUIRE(minefield.get_hash() == zobrist::hash_of(minefield));
+	}
+	REQUIRE(minefield.get_hash() != fresh.get_hash());
+	for (auto const& [pos, cell] : minefield) {
+		if (cell.is_bomb() && !minefield.is_game_won()) {
+			minefield.expose(pos);
+			REQUIRE(minefield.is_game_lost());
+			REQUIRE(minefield.get_hash() == zobrist::hash_of(minefield));
+			break;
+		}
+	}
+	REQUIRE(fresh.get_hash() == zobrist::hash_of(fresh));
+
+	SECTION("Equal boards hash equal, whatever the order of moves") {
+		std::vector<Pos> const mines{ Pos{ 1, 1 }, Pos{ 4, 0 }, Pos{ 5, 5 } };
+		Minefield forward{ 6, 6, mines };
+		Minefield backward{ 6, 6, mines };
+		forward.expose({ 0, 5 });
+		forward.toggle_flagged({ 1, 1 });
+		forward.expose({ 3, 0 });
+		backward.toggle_flagged({ 5, 5 });
+		backward.expose({ 3, 0 });
+		backward.toggle_flagged({ 1, 1 });
+		backward.expose({ 0, 5 });
+		REQUIRE(forward.get_hash() != backward.get_hash());
+		backward.toggle_flagged({ 5, 5 });
+		REQUIRE(forward.get_hash() == backward.get_hash());
+
+		// Same cells on a board of another size or mine count
+		REQUIRE(Minefield(6, 6, mines).get_hash() != Minefield(6, 7, mines).get_hash());
+		REQUIRE(Minefield(6, 6, mines).get_hash() != Minefield(6, 6, { Pos{ 1, 1 } }).get_hash());
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../lib/util.h"
+
+namespace solver {
+
+/*
+* A cell of a BoardView, read from its byte: 0 to 8 is exposed and shows that number, covered and flagged
+* are the two values after that.
+*/
+class ByteCell {
+    std::uint8_t value;
+
+public:
+    static constexpr std::uint8_t covered = 9;
+    static constexpr std::uint8_t flagged = 10;
+
+    explicit ByteCell(std::uint8_t value) : value{ value } {}
+
+    bool is_exposed() const { return value <= 8; }
+    bool is_covered() const { return !is_exposed(); }
+    bool is_flagged() const { return value == flagged; }
+    int get_num_adjacent_bombs() const { return is_exposed() ? value : 0; }
+};
+
+/*
+* A board that belongs to someone else, read where it is: one byte per cell as in ByteCell, row after row,
+* stride bytes from the start of one row to the next. It has what the solver asks of a board, so
+* find_next_moves and the other solver templates run on it directly. The bytes have to outlive the view.
+*/
+class BoardView {
+    std::uint8_t const* cells;
+    int width;
+    int height;
+    int stride;
+    int num_mines;
+    int num_exposed = 0;
+
+public:
+    BoardView(std::uint8_t const* cells, int width, int height, int stride, int num_mines)
+        : cells{ cells }
+        , width{ width }
+        , height{ height }
+        , stride{ stride }
+        , num_mines{ num_mines }
+    {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                num_exposed += get_cell({ x, y }).is_exposed();
+            }
+        }
+    }
+
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+    int get_num_mines() const { return num_mines; }
+    int count_exposed_cells() const { return num_exposed; }
+
+    // The offset can be past what an int holds, with a stride much wider than the board
+    ByteCell get_cell(util::Pos const& pos) const {
+        return ByteCell{ cells[static_cast<std::ptrdiff_t>(pos.y) * stride + pos.x] };
+    }
+};
+
+} // namespace solver
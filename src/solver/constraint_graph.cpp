@@ -0,0 +1,57 @@
+#include "constraint_graph.h"
+
+#include "../model/minefield.h"
+#include "../lib/util.h"
+
+using util::Pos;
+
+namespace solver {
+
+ConstraintGraph::ConstraintGraph(std::pmr::memory_resource* memory)
+    : variable_pos(memory)
+    , variable_offsets(memory)
+    , variable_constraints(memory)
+    , constraint_pos(memory)
+    , constraint_offsets(memory)
+    , constraint_vars(memory)
+    , interior_pos(memory)
+    , variable_state(memory)
+    , constraint_remaining(memory)
+    , constraint_unknown(memory)
+{}
+
+void ConstraintGraph::assign(int var, VarState state) {
+    variable_state[var] = state;
+    for (int c : constraints_of(var)) {
+        --constraint_unknown[c];
+        if (state == VarState::Bomb) {
+            --constraint_remaining[c];
+        }
+    }
+}
+
+void ConstraintGraph::unassign(int var) {
+    for (int c : constraints_of(var)) {
+        ++constraint_unknown[c];
+        if (variable_state[var] == VarState::Bomb) {
+            ++constraint_remaining[c];
+        }
+    }
+    variable_state[var] = VarState::Unknown;
+}
+
+bool ConstraintGraph::is_satisfiable_around(int var) const {
+    for (int c : constraints_of(var)) {
+        if (constraint_remaining[c] < 0 || constraint_remaining[c] > constraint_unknown[c]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void compile_constraint_graph(Minefield const& minefield, ConstraintGraph& graph) {
+    util::DynamicTopology const topology{ minefield.get_width(), minefield.get_height() };
+    compile_constraint_graph(minefield, topology, graph);
+}
+
+} // namespace solver
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "../lib/topology.h"
+#include "../lib/trace.h"
+#include "../lib/util.h"
+
+// Forward declarations
+class Minefield;
+template<int Width, int Height> class FixedMinefield;
+
+namespace solver {
+
+enum class VarState : std::int8_t {
+    Unknown,
+    Safe,
+    Bomb
+};
+
+// A contiguous run of indices inside one of the CSR arrays
+struct IndexRange {
+    int const* first = nullptr;
+    int const* last = nullptr;
+
+    int const* begin() const { return first; }
+    int const* end() const { return last; }
+    int size() const { return static_cast<int>(last - first); }
+};
+
+/*
+* The frontier of a minefield compiled into flat arrays, so the search never has to go back to the Minefield.
+* Variables are covered cells next to at least one exposed number, constraints are exposed numbers next to at
+* least one covered cell. Both are numbered in board order.
+* Adjacency is stored both ways in CSR form: the variables of constraint c are
+* constraint_vars[constraint_offsets[c]] up to constraint_vars[constraint_offsets[c + 1]], and likewise for the
+* constraints of a variable.
+*/
+struct ConstraintGraph {
+    std::pmr::vector<util::Pos> variable_pos;
+    std::pmr::vector<int> variable_offsets;
+    std::pmr::vector<int> variable_constraints;
+
+    std::pmr::vector<util::Pos> constraint_pos;
+    std::pmr::vector<int> constraint_offsets;
+    std::pmr::vector<int> constraint_vars;
+
+    // Covered cells that are not next to any number, in board order. They only matter for the mine count.
+    std::pmr::vector<util::Pos> interior_pos;
+
+    // Search state, kept up to date by assign() and unassign()
+    std::pmr::vector<VarState> variable_state;
+    std::pmr::vector<int> constraint_remaining; // bombs still to be placed around the constraint, can go negative
+    std::pmr::vector<int> constraint_unknown;   // variables around the constraint that are still Unknown
+
+    explicit ConstraintGraph(std::pmr::memory_resource* memory);
+
+    int num_variables() const { return static_cast<int>(variable_pos.size()); }
+    int num_constraints() const { return static_cast<int>(constraint_pos.size()); }
+
+    IndexRange constraints_of(int var) const {
+        return { variable_constraints.data() + variable_offsets[var],
+                 variable_constraints.data() + variable_offsets[var + 1] };
+    }
+    IndexRange variables_of(int constraint) const {
+        return { constraint_vars.data() + constraint_offsets[constraint],
+                 constraint_vars.data() + constraint_offsets[constraint + 1] };
+    }
+
+    // Give an Unknown variable a value, and update the counters of all its constraints
+    void assign(int var, VarState state);
+    // Make a variable Unknown again, undoing assign()
+    void unassign(int var);
+
+    // Forward check: every constraint around var can still be satisfied by the Unknown variables left around it
+    bool is_satisfiable_around(int var) const;
+};
+
+/*
+* Compile the visible state of a board. Flags are ignored, flagged cells count as covered.
+* Board is Minefield, a FixedMinefield or a BoardView, Topology the matching util::DynamicTopology or util::FixedTopology, so
+* boards of a compile time size get their neighbour loops unrolled.
+*/
+template<typename Board, typename Topology>
+void compile_constraint_graph(Board const& board, Topology const& topology, ConstraintGraph& graph) {
+    TRACE_SCOPE("compile constraint graph");
+    int const width = board.get_width();
+    int const num_cells = topology.num_cells();
+    std::pmr::memory_resource* memory = graph.variable_pos.get_allocator().resource();
+
+    // A reference for boards that store their cells, a value for views that decode them
+    auto cell_at = [&](int index) -> decltype(auto) {
+        return board.get_cell(util::Pos{ index % width, index / width });
+    };
+
+    // Number of covered cells around every cell, for the whole board in one go
+    std::pmr::vector<std::uint8_t> covered_plane(num_cells + 1, 0, memory); // last one is the padding cell
+    for (int i = 0; i < num_cells; ++i) {
+        covered_plane[i] = cell_at(i).is_covered();
+    }
+    std::pmr::vector<std::uint8_t> num_covered_neighbours(num_cells, memory);
+    topology.count_neighbours(covered_plane.data(), num_covered_neighbours.data());
+
+    // Pass 1: find the constraints, and flag their covered neighbours as variables
+    constexpr int no_variable = -1;
+    constexpr int frontier = -2;
+    std::pmr::vector<int> variable_index(num_cells, no_variable, memory);
+    std::pmr::vector<int> constraint_index(memory);
+    for (int i = 0; i < num_cells; ++i) {
+        auto const& cell = cell_at(i);
+        if (cell.is_exposed() && cell.get_num_adjacent_bombs() > 0 && num_covered_neighbours[i] > 0) {
+            constraint_index.push_back(i);
+            graph.constraint_pos.emplace_back(i % width, i / width);
+            topology.for_each_neighbour(i, [&](int n) {
+                if (covered_plane[n]) {
+                    variable_index[n] = frontier;
+                }
+                });
+        }
+    }
+
+    // Pass 2: number the variables in board order, the other covered cells are interior
+    for (int i = 0; i < num_cells; ++i) {
+        if (variable_index[i] == frontier) {
+            variable_index[i] = graph.num_variables();
+            graph.variable_pos.emplace_back(i % width, i / width);
+        }
+        else if (covered_plane[i]) {
+            graph.interior_pos.emplace_back(i % width, i / width);
+        }
+    }
+
+    // Constraint -> variables
+    graph.constraint_offsets.push_back(0);
+    for (int i : constraint_index) {
+        topology.for_each_neighbour(i, [&](int n) {
+            if (covered_plane[n]) {
+                graph.constraint_vars.push_back(variable_index[n]);
+            }
+            });
+        graph.constraint_offsets.push_back(static_cast<int>(graph.constraint_vars.size()));
+        graph.constraint_remaining.push_back(cell_at(i).get_num_adjacent_bombs());
+        graph.constraint_unknown.push_back(num_covered_neighbours[i]);
+    }
+
+    // Variable -> constraints, by transposing the above
+    graph.variable_offsets.assign(graph.num_variables() + 1, 0);
+    for (int var : graph.constraint_vars) {
+        ++graph.variable_offsets[var + 1];
+    }
+    for (int v = 0; v < graph.num_variables(); ++v) {
+        graph.variable_offsets[v + 1] += graph.variable_offsets[v];
+    }
+    graph.variable_constraints.resize(graph.constraint_vars.size());
+    std::pmr::vector<int> fill_pos{ graph.variable_offsets.begin(), graph.variable_offsets.end() - 1, memory };
+    for (int c = 0; c < graph.num_constraints(); ++c) {
+        for (int var : graph.variables_of(c)) {
+            graph.variable_constraints[fill_pos[var]++] = c;
+        }
+    }
+
+    graph.variable_state.assign(graph.num_variables(), VarState::Unknown);
+}
+
+// Same as above for a Minefield, with the topology of its runtime size
+void compile_constraint_graph(Minefield const& minefield, ConstraintGraph& graph);
+
+// Same as above for a FixedMinefield, with its compile time topology
+template<int Width, int Height>
+void compile_constraint_graph(FixedMinefield<Width, Height> const& minefield, ConstraintGraph& graph) {
+    compile_constraint_graph(minefield, util::FixedTopology<Width, Height>{}, graph);
+}
+
+// Any other kind of board, like a view of a board with a change on top
+template<typename Board>
+void compile_constraint_graph(Board const& board, ConstraintGraph& graph) {
+    compile_constraint_graph(board, util::DynamicTopology{ board.get_width(), board.get_height() }, graph);
+}
+
+} // namespace solver
@@ -0,0 +1,220 @@
+#include "endgame_tree.h"
+
+#include "solver.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory_resource>
+#include <unordered_map>
+
+using util::Pos;
+
+namespace { // Anonymous namespace
+
+using Cells = std::uint32_t; // one bit per covered cell
+
+static_assert(solver::endgame_tree_max_cells <= 16, "the numbers of all covered cells have to fit in 64 bits");
+
+int count_cells(Cells cells) {
+    int count = 0;
+    for (; cells != 0; cells &= cells - 1) {
+        ++count;
+    }
+    return count;
+}
+
+int lowest_cell(Cells cells) {
+    int cell = 0;
+    while (((cells >> cell) & 1) == 0) {
+        ++cell;
+    }
+    return cell;
+}
+
+// Bomb placements that still fit, as a range inside a buffer owned further up the search
+struct Placements {
+    Cells const* first;
+    Cells const* last;
+
+    Cells const* begin() const { return first; }
+    Cells const* end() const { return last; }
+    std::size_t size() const { return static_cast<std::size_t>(last - first); }
+};
+
+// What has been revealed so far. numbers holds 4 bits per covered cell, valid where the cell is revealed.
+struct TreeKey {
+    Cells revealed;
+    std::uint64_t numbers;
+
+    bool operator==(TreeKey const& other) const { return revealed == other.revealed && numbers == other.numbers; }
+};
+
+struct TreeKeyHash {
+    std::size_t operator()(TreeKey const& key) const {
+        return std::hash<std::uint64_t>{}((key.numbers * 0x9E3779B97F4A7C15ull) ^ key.revealed);
+    }
+};
+
+struct TreeSearch {
+    std::array<Cells, solver::endgame_tree_max_cells> neighbours; // covered neighbours of each covered cell
+    Cells all_cells;
+    int num_mines;
+    int nodes_left;
+    solver::SearchControl* control;
+    std::uint64_t num_nodes;
+    bool cancelled;
+    // One buffer of placements_per_depth for each number of revealed cells. The placements a child is given stay
+    // where its parent put them, so a reveal only overwrites the buffer of its own depth.
+    Cells* scratch;
+    std::size_t placements_per_depth;
+    std::pmr::unordered_map<TreeKey, double, TreeKeyHash> transpositions;
+};
+
+double win_probability(TreeSearch& search, Placements placements, TreeKey key);
+
+/*
+* Chance to win after revealing cell, given the placements that fit so far.
+* The placements where cell is safe are grouped by the number it shows, each group is one child position.
+*/
+double reveal_value(TreeSearch& search, Placements placements, TreeKey key, int cell) {
+    Cells* const safe = search.scratch + count_cells(key.revealed) * search.placements_per_depth;
+    Cells* const safe_end = std::copy_if(placements.begin(), placements.end(), safe,
+        [cell](Cells placement) { return ((placement >> cell) & 1) == 0; });
+    auto number_at = [&](Cells placement) { return count_cells(placement & search.neighbours[cell]); };
+    std::sort(safe, safe_end, [&](Cells lhs, Cells rhs) { return number_at(lhs) < number_at(rhs); });
+
+    double num_won = 0;
+    for (Cells* first = safe; first != safe_end; ) {
+        int const number = number_at(*first);
+        Cells* const last = std::find_if(first, safe_end, [&](Cells placement) { return number_at(placement) != number; });
+
+        TreeKey const child{ key.revealed | (Cells{ 1 } << cell), key.numbers | (std::uint64_t(number) << (4 * cell)) };
+        num_won += (last - first) * win_probability(search, Placements{ first, last }, child);
+        first = last;
+    }
+    return num_won / placements.size();
+}
+
+/*
+* Chance to win from a position, playing the best move each time.
+* A cell that is safe in every placement is always worth revealing first, it can only add information.
+*/
+double win_probability(TreeSearch& search, Placements placements, TreeKey key) {
+    Cells const unrevealed = search.all_cells & ~key.revealed;
+    if (count_cells(unrevealed) == search.num_mines) {
+        return 1; // only the bombs are left
+    }
+
+    auto const known = search.transpositions.find(key);
+    if (known != search.transpositions.end()) {
+        return known->second;
+    }
+    if (search.control != nullptr && ++search.num_nodes % solver::SearchControl::check_interval == 0) {
+        search.cancelled = search.control->check(search.num_nodes);
+    }
+    if (search.cancelled || --search.nodes_left < 0) {
+        return 0; // the caller throws away everything once the budget is gone or the search is cancelled
+    }
+
+    Cells maybe_bomb = 0;
+    for (Cells placement : placements) {
+        maybe_bomb |= placement;
+    }
+
+    double best;
+    Cells const certainly_safe = unrevealed & ~maybe_bomb;
+    if (certainly_safe != 0) {
+        best = reveal_value(search, placements, key, lowest_cell(certainly_safe));
+    }
+    else {
+        best = 0;
+        for (Cells cells = unrevealed; cells != 0 && best < 1; cells &= cells - 1) {
+            best = std::max(best, reveal_value(search, placements, key, lowest_cell(cells)));
+        }
+    }
+
+    search.transpositions.emplace(key, best);
+    return best;
+}
+
+} // End anonymous namespace
+
+namespace solver {
+
+std::optional<EndgameMove> search_endgame_tree(ConstraintGraph const& graph, int num_mines, util::Arena& arena,
+    SearchControl* control) {
+
+    // Covered cells are numbered like the variables, followed by the interior cells
+    std::pmr::vector<Pos> covered{ graph.variable_pos.begin(), graph.variable_pos.end(), &arena };
+    covered.insert(covered.end(), graph.interior_pos.begin(), graph.interior_pos.end());
+    int const num_cells = static_cast<int>(covered.size());
+    if (num_cells == 0 || num_cells > endgame_tree_max_cells) {
+        return {};
+    }
+
+    TreeSearch search{ {}, (Cells{ 1 } << num_cells) - 1, num_mines, endgame_tree_max_nodes, control, 0, false, nullptr, 0,
+        std::pmr::unordered_map<TreeKey, double, TreeKeyHash>{ &arena } };
+    for (int a = 0; a < num_cells; ++a) {
+        for (int b = 0; b < num_cells; ++b) {
+            bool const adjacent = a != b
+                && std::abs(covered[a].x - covered[b].x) <= 1
+                && std::abs(covered[a].y - covered[b].y) <= 1;
+            search.neighbours[a] |= Cells{ adjacent } << b;
+        }
+    }
+
+    // Every placement of exactly num_mines bombs that fits all the numbers
+    std::pmr::vector<Cells> constraint_cells(graph.num_constraints(), 0, &arena);
+    for (int c = 0; c < graph.num_constraints(); ++c) {
+        for (int var : graph.variables_of(c)) {
+            constraint_cells[c] |= Cells{ 1 } << var;
+        }
+    }
+    std::pmr::vector<Cells> placements(&arena);
+    for (Cells placement = 0; placement <= search.all_cells; ++placement) {
+        if (count_cells(placement) != num_mines) {
+            continue;
+        }
+        bool fits = true;
+        for (int c = 0; c < graph.num_constraints() && fits; ++c) {
+            fits = count_cells(placement & constraint_cells[c]) == graph.constraint_remaining[c];
+        }
+        if (fits) {
+            placements.push_back(placement);
+        }
+    }
+    if (placements.empty()) {
+        return {};
+    }
+    // A cell is revealed with between 0 and num_cells - 1 others revealed before it
+    std::pmr::vector<Cells> scratch(num_cells * placements.size(), 0, &arena);
+    search.scratch = scratch.data();
+    search.placements_per_depth = placements.size();
+
+    Placements const all{ placements.data(), placements.data() + placements.size() };
+    TreeKey const root{ 0, 0 };
+    EndgameMove best;
+    best.win_probability = -1;
+    for (int cell = 0; cell < num_cells && !search.cancelled; ++cell) {
+        double const win = reveal_value(search, all, root, cell);
+        if (win > best.win_probability) {
+            best.pos = covered[cell];
+            best.win_probability = win;
+            best.safe_probability = static_cast<double>(std::count_if(placements.begin(), placements.end(),
+                [cell](Cells placement) { return ((placement >> cell) & 1) == 0; })) / placements.size();
+        }
+    }
+
+    if (control != nullptr) {
+        control->add_nodes(search.num_nodes);
+    }
+    if (search.nodes_left < 0 || search.cancelled) {
+        return {};
+    }
+    return best;
+}
+
+} // namespace solver
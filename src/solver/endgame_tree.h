@@ -0,0 +1,34 @@
+#pragma once
+
+#include "constraint_graph.h"
+
+#include "../lib/arena.h"
+#include "../lib/util.h"
+
+#include <optional>
+
+namespace solver {
+
+class SearchControl;
+
+struct EndgameMove {
+    util::Pos pos;
+    double safe_probability = 0; // chance that pos is not a bomb
+    double win_probability = 0;  // chance to win the game, playing pos and then the best moves after it
+};
+
+// Upper bound on the positions visited by one tree search, it gives up beyond that
+constexpr int endgame_tree_max_nodes = 200000;
+
+/*
+* Search the game tree of an endgame for the move with the best chance to win.
+* Every full bomb placement on the covered cells (frontier and interior of the freshly compiled graph) with exactly
+* num_mines bombs is listed, and each move splits them by the number it would reveal. Positions reached in more
+* than one order are looked up in a transposition table keyed on the cells revealed and their numbers.
+* Returns nothing when there are more than endgame_tree_max_cells covered cells, no placement fits, or the search
+* runs out of nodes or is cancelled through control. All memory comes from arena, which is not reset.
+*/
+std::optional<EndgameMove> search_endgame_tree(ConstraintGraph const& graph, int num_mines, util::Arena& arena,
+    SearchControl* control = nullptr);
+
+} // namespace solver
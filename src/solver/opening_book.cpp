@@ -0,0 +1,150 @@
+#include "opening_book.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+using util::Pos;
+
+namespace { // Anonymous namespace
+
+constexpr std::uint32_t file_magic = 0x424F4D57; // "WMOB"
+constexpr std::uint32_t file_version = 1;
+
+// Probabilities are stored as 16 bit fixed point
+constexpr float fixed_point_one = 65535.f;
+
+bool same_settings(util::GameSettings const& lhs, util::GameSettings const& rhs) {
+    return lhs.width == rhs.width && lhs.height == rhs.height && lhs.num_bombs == rhs.num_bombs;
+}
+
+std::shared_ptr<solver::OpeningBook const> current_opening_book = std::make_shared<solver::OpeningBook const>();
+
+} // End anonymous namespace
+
+namespace solver {
+
+void OpeningBook::add(util::GameSettings settings, std::vector<Opening> openings) {
+    auto const existing = std::find_if(entries.begin(), entries.end(), [&](Entry const& entry) {
+        return same_settings(entry.settings, settings);
+        });
+    if (existing != entries.end()) {
+        existing->openings = std::move(openings);
+    }
+    else {
+        entries.push_back(Entry{ settings, std::move(openings) });
+    }
+}
+
+std::vector<OpeningBook::Opening> const* OpeningBook::find(util::GameSettings settings) const {
+    for (Entry const& entry : entries) {
+        if (same_settings(entry.settings, settings)) {
+            return &entry.openings;
+        }
+    }
+    return nullptr;
+}
+
+/*
+* File layout, all little endian 32 bit words unless noted:
+* magic, version, number of entries, then per entry width, height, number of mines, followed by
+* two 16 bit fixed point probabilities per cell, zero then win.
+*/
+std::optional<OpeningBook> OpeningBook::load(std::string const& path) {
+    std::ifstream file{ path, std::ios::binary };
+    std::array<std::uint32_t, 3> header{};
+    if (!file.read(reinterpret_cast<char*>(header.data()), sizeof(header))) {
+        return {};
+    }
+    if (header[0] != file_magic || header[1] != file_version) {
+        std::cout << "Not an opening book: " << path << '\n';
+        return {};
+    }
+
+    OpeningBook book;
+    for (std::uint32_t e = 0; e < header[2]; ++e) {
+        std::array<std::uint32_t, 3> settings{};
+        file.read(reinterpret_cast<char*>(settings.data()), sizeof(settings));
+        std::size_t const num_cells = static_cast<std::size_t>(settings[0]) * settings[1];
+        std::vector<std::uint16_t> fixed(2 * num_cells);
+        if (!file || num_cells > 1u << 20
+            || !file.read(reinterpret_cast<char*>(fixed.data()), fixed.size() * sizeof(std::uint16_t))) {
+            std::cout << "Opening book is cut short: " << path << '\n';
+            return {};
+        }
+
+        std::vector<Opening> openings(num_cells);
+        for (std::size_t i = 0; i < num_cells; ++i) {
+            openings[i] = Opening{ fixed[2 * i] / fixed_point_one, fixed[2 * i + 1] / fixed_point_one };
+        }
+        book.add({ static_cast<int>(settings[0]), static_cast<int>(settings[1]), static_cast<int>(settings[2]) },
+            std::move(openings));
+    }
+    return book;
+}
+
+bool OpeningBook::save(std::string const& path) const {
+    std::ofstream file{ path, std::ios::binary };
+    std::array<std::uint32_t, 3> const header{ file_magic, file_version, static_cast<std::uint32_t>(entries.size()) };
+    file.write(reinterpret_cast<char const*>(header.data()), sizeof(header));
+    for (Entry const& entry : entries) {
+        std::array<std::uint32_t, 3> const settings{ static_cast<std::uint32_t>(entry.settings.width),
+            static_cast<std::uint32_t>(entry.settings.height), static_cast<std::uint32_t>(entry.settings.num_bombs) };
+        file.write(reinterpret_cast<char const*>(settings.data()), sizeof(settings));
+
+        std::vector<std::uint16_t> fixed;
+        for (Opening const& opening : entry.openings) {
+            fixed.push_back(static_cast<std::uint16_t>(opening.zero_probability * fixed_point_one + .5f));
+            fixed.push_back(static_cast<std::uint16_t>(opening.win_probability * fixed_point_one + .5f));
+        }
+        file.write(reinterpret_cast<char const*>(fixed.data()), fixed.size() * sizeof(std::uint16_t));
+    }
+    return static_cast<bool>(file);
+}
+
+std::shared_ptr<OpeningBook const> opening_book() {
+    return std::atomic_load(&current_opening_book);
+}
+
+void set_opening_book(std::shared_ptr<OpeningBook const> book) {
+    std::atomic_store(&current_opening_book, std::move(book));
+}
+
+/*
+* The other num_cells - 1 cells get the mines uniformly, and none of them may land on the neighbours:
+* C(num_cells - 1 - neighbours, mines) / C(num_cells - 1, mines), computed as a product to stay in range.
+*/
+double first_click_zero_probability(util::GameSettings settings, Pos pos) {
+    int num_neighbours = 0;
+    util::for_each_adjacent_position(pos, settings.width, settings.height, [&](Pos) { ++num_neighbours; });
+
+    int const num_other = settings.width * settings.height - 1;
+    double probability = 1;
+    for (int i = 0; i < num_neighbours; ++i) {
+        probability *= std::max(0., static_cast<double>(num_other - settings.num_bombs - i) / (num_other - i));
+    }
+    return probability;
+}
+
+Pos best_first_click(util::GameSettings settings, OpeningBook const& book) {
+    std::vector<OpeningBook::Opening> const* const openings = book.find(settings);
+
+    Pos best{ 0, 0 };
+    double best_score = -1;
+    for (int y = 0; y < settings.height; ++y) {
+        for (int x = 0; x < settings.width; ++x) {
+            double const score = openings != nullptr ?
+                (*openings)[y * settings.width + x].win_probability :
+                first_click_zero_probability(settings, { x, y });
+            if (score > best_score) {
+                best = { x, y };
+                best_score = score;
+            }
+        }
+    }
+    return best;
+}
+
+} // namespace solver
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../lib/util.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace solver {
+
+/*
+* Where to click first, per board configuration. For every cell, how often a first click there opened a zero
+* region and how often the game was won, measured by playing headless games (see simulation::generate_openings).
+*/
+class OpeningBook {
+public:
+    struct Opening {
+        float zero_probability = 0;
+        float win_probability = 0;
+    };
+
+    // A book that knows no configurations
+    OpeningBook() = default;
+
+    // Read a book written by save(). Nothing if the file is missing or not an opening book.
+    static std::optional<OpeningBook> load(std::string const& path);
+    bool save(std::string const& path) const;
+
+    // openings holds one entry per cell, index = y*width + x. Replaces what the book had for these settings.
+    void add(util::GameSettings settings, std::vector<Opening> openings);
+
+    // All cells for these settings, or null when the book does not have them
+    std::vector<Opening> const* find(util::GameSettings settings) const;
+
+    int size() const { return static_cast<int>(entries.size()); }
+
+private:
+    struct Entry {
+        util::GameSettings settings;
+        std::vector<Opening> openings;
+    };
+    std::vector<Entry> entries;
+};
+
+// The book best_blind_click plays from on an untouched board, empty until one is set. Safe to call from any thread.
+std::shared_ptr<OpeningBook const> opening_book();
+void set_opening_book(std::shared_ptr<OpeningBook const> book);
+
+// Chance that the first click at pos exposes a zero. Mines are placed after the first click, never on it.
+double first_click_zero_probability(util::GameSettings settings, util::Pos pos);
+
+// The first click that wins most often according to the book, or when the book does not have these settings,
+// the one most likely to open a zero region
+util::Pos best_first_click(util::GameSettings settings, OpeningBook const& book);
+
+/*
+* Where to click when the solver has nothing to go on: the best first click on an untouched board, otherwise the
+* covered cell away from all numbers with the fewest covered neighbours, as that is the most likely to open a zero.
+* Board is Minefield or a FixedMinefield.
+*/
+template<typename Board>
+util::Pos best_blind_click(Board const& board) {
+    int const width = board.get_width();
+    int const height = board.get_height();
+    if (board.count_exposed_cells() == 0) {
+        return best_first_click({ width, height, board.get_num_mines() }, *opening_book());
+    }
+
+    util::Pos best;
+    int best_covered = 9;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (!board.get_cell({ x, y }).is_covered()) {
+                continue;
+            }
+            int num_covered = 0;
+            bool next_to_number = false;
+            util::for_each_adjacent_position({ x, y }, width, height, [&](util::Pos p) {
+                auto const& cell = board.get_cell(p);
+                num_covered += cell.is_covered();
+                next_to_number = next_to_number || (cell.get_num_adjacent_bombs() > 0 && cell.is_exposed());
+                });
+            if (!next_to_number && num_covered < best_covered) {
+                best = { x, y };
+                best_covered = num_covered;
+            }
+        }
+    }
+    if (best_covered == 9) { // every covered cell is next to a number, take any of them
+        for (int i = 0; i < width * height && best_covered == 9; ++i) {
+            if (board.get_cell({ i % width, i / width }).is_covered()) {
+                best = { i % width, i / width };
+                best_covered = 0;
+            }
+        }
+    }
+    return best;
+}
+
+} // namespace solver
@@ -0,0 +1,328 @@
+#include "pattern_table.h"
+
+#include "solver.h"
+
+#include "../lib/arena.h"
+#include "../lib/topology.h"
+#include "../lib/trace.h"
+#include "../model/minefield.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using util::Pos;
+
+namespace { // Anonymous namespace
+
+constexpr std::uint32_t file_magic = 0x54504D57; // "WMPT"
+constexpr std::uint32_t file_version = 1;
+
+// Pattern keys are 22 bits, so a table this size holds every pattern there is and is still half empty
+constexpr std::uint32_t max_slots = 1u << 23;
+
+/*
+* The second number of a pair sits at one of these offsets from the first. Together with swapping the two,
+* that covers every pair of adjacent numbers.
+*/
+constexpr std::array<std::array<int, 2>, 4> pair_offsets{ { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } } };
+
+// Offsets from the first number are at most 2 in any direction, so windows live in a 5x5 grid
+constexpr int grid_size = 5;
+
+// The covered cells that can take part in a pattern: the neighbours of both numbers, in board order
+struct Window {
+    std::array<Pos, 12> cells;             // offsets from the first number
+    int num_cells = 0;
+    std::array<int, grid_size * grid_size> index_of; // window cell at grid offset, or -1
+    std::uint16_t around_first = 0;       // window cells next to the first number
+    std::uint16_t around_second = 0;      // window cells next to the second number
+};
+
+std::array<Window, pair_offsets.size()> make_windows() {
+    std::array<Window, pair_offsets.size()> windows;
+    for (std::size_t orientation = 0; orientation < pair_offsets.size(); ++orientation) {
+        Window& window = windows[orientation];
+        window.index_of.fill(-1);
+        int const second_x = pair_offsets[orientation][0];
+        int const second_y = pair_offsets[orientation][1];
+        for (int dy = -2; dy <= 2; ++dy) {
+            for (int dx = -2; dx <= 2; ++dx) {
+                bool const is_number = (dx == 0 && dy == 0) || (dx == second_x && dy == second_y);
+                bool const near_first = std::abs(dx) <= 1 && std::abs(dy) <= 1;
+                bool const near_second = std::abs(dx - second_x) <= 1 && std::abs(dy - second_y) <= 1;
+                if (is_number || (!near_first && !near_second)) {
+                    continue;
+                }
+                int const index = window.num_cells++;
+                window.cells[index] = Pos{ dx, dy };
+                window.index_of[(dy + 2) * grid_size + dx + 2] = index;
+                window.around_first |= near_first << index;
+                window.around_second |= near_second << index;
+            }
+        }
+    }
+    return windows;
+}
+
+std::array<Window, pair_offsets.size()> const& windows() {
+    static std::array<Window, pair_offsets.size()> const windows = make_windows();
+    return windows;
+}
+
+std::uint32_t pattern_key(int orientation, std::uint32_t covered, int first_number, int second_number) {
+    return orientation | covered << 2 | first_number << 14 | second_number << 18;
+}
+
+std::uint32_t hash(std::uint32_t pattern) {
+    return pattern * 0x9E3779B1u;
+}
+
+int count_cells(std::uint32_t cells) {
+    int count = 0;
+    for (; cells != 0; cells &= cells - 1) {
+        ++count;
+    }
+    return count;
+}
+
+/*
+* A 5x5 board holding nothing but one pattern, with the first number in the middle.
+* Every cell outside the window is exposed with no bombs around it, so it plays no part.
+*/
+struct PatternBoard {
+    std::array<Cell, grid_size * grid_size> cells;
+
+    PatternBoard(Window const& window, std::array<int, 2> second, std::uint32_t covered, int first_number, int second_number) {
+        for (Cell& cell : cells) {
+            cell.expose();
+        }
+        for (int i = 0; i < window.num_cells; ++i) {
+            if ((covered >> i) & 1) {
+                cells[(window.cells[i].y + 2) * grid_size + window.cells[i].x + 2] = Cell{};
+            }
+        }
+        cells[2 * grid_size + 2].set_num_adjacent_bombs(first_number);
+        cells[(second[1] + 2) * grid_size + second[0] + 2].set_num_adjacent_bombs(second_number);
+    }
+
+    int get_width() const { return grid_size; }
+    Cell const& get_cell(Pos const& pos) const { return cells[pos.y * grid_size + pos.x]; }
+};
+
+} // End anonymous namespace
+
+namespace solver {
+
+void PatternTable::insert(std::uint32_t pattern, Deduction deduction) {
+    std::uint32_t const mask = static_cast<std::uint32_t>(slots.size()) - 1;
+    for (std::uint32_t i = hash(pattern) & mask; ; i = (i + 1) & mask) {
+        if (slots[i].pattern == empty_slot) {
+            slots[i] = Slot{ pattern, deduction };
+            ++num_patterns;
+            return;
+        }
+    }
+}
+
+std::optional<PatternTable::Deduction> PatternTable::lookup(std::uint32_t pattern) const {
+    if (slots.empty()) {
+        return {};
+    }
+    std::uint32_t const mask = static_cast<std::uint32_t>(slots.size()) - 1;
+    for (std::uint32_t i = hash(pattern) & mask; slots[i].pattern != empty_slot; i = (i + 1) & mask) {
+        if (slots[i].pattern == pattern) {
+            return slots[i].deduction;
+        }
+    }
+    return {};
+}
+
+PatternTable PatternTable::generate() {
+    std::vector<Slot> found;
+    util::Arena arena;
+    board_state_result result;
+
+    for (int orientation = 0; orientation < static_cast<int>(pair_offsets.size()); ++orientation) {
+        Window const& window = windows()[orientation];
+        for (std::uint32_t covered = 0; covered < (1u << window.num_cells); ++covered) {
+            int const around_first = count_cells(covered & window.around_first);
+            int const around_second = count_cells(covered & window.around_second);
+            for (int first_number = 1; first_number <= around_first; ++first_number) {
+                for (int second_number = 1; second_number <= around_second; ++second_number) {
+                    PatternBoard const board{ window, pair_offsets[orientation], covered, first_number, second_number };
+
+                    arena.reset();
+                    ConstraintGraph graph{ &arena };
+                    compile_constraint_graph(board, util::DynamicTopology{ grid_size, grid_size }, graph);
+                    solve_constraint_graph(graph, grid_size * grid_size, arena, result);
+                    if (result.num_solutions == 0) {
+                        continue; // the numbers contradict each other
+                    }
+
+                    auto to_window = [&](std::vector<Pos> const& positions) {
+                        std::uint16_t cells = 0;
+                        for (Pos const& pos : positions) {
+                            cells |= 1 << window.index_of[pos.y * grid_size + pos.x];
+                        }
+                        return cells;
+                    };
+                    Deduction deduction;
+                    if (result.safe_certainty == 1) {
+                        deduction.safe = to_window(result.safest_positions);
+                    }
+                    if (result.unsafe_certainty == 1) {
+                        deduction.bombs = to_window(result.unsafest_positions);
+                    }
+                    if (deduction.safe != 0 || deduction.bombs != 0) {
+                        found.push_back(Slot{ pattern_key(orientation, covered, first_number, second_number), deduction });
+                    }
+                }
+            }
+        }
+    }
+
+    PatternTable table;
+    std::size_t num_slots = 1;
+    while (num_slots < 2 * found.size()) {
+        num_slots *= 2;
+    }
+    table.slots.assign(num_slots, Slot{ empty_slot, {} });
+    for (Slot const& slot : found) {
+        table.insert(slot.pattern, slot.deduction);
+    }
+    return table;
+}
+
+std::optional<PatternTable> PatternTable::load(std::string const& path) {
+    std::ifstream file{ path, std::ios::binary };
+    std::array<std::uint32_t, 4> header{};
+    if (!file.read(reinterpret_cast<char*>(header.data()), sizeof(header))) {
+        return {};
+    }
+    auto const [magic, version, num_slots, num_patterns] = header;
+    if (magic != file_magic || version != file_version || num_slots > max_slots || (num_slots & (num_slots - 1)) != 0
+        || num_patterns >= num_slots) {
+        std::cout << "Not a pattern table: " << path << '\n';
+        return {};
+    }
+
+    // Check the size before allocating anything, the header could say anything
+    std::streamoff const start = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff const end = file.tellg();
+    if (end - start != static_cast<std::streamoff>(num_slots * sizeof(Slot)) || !file.seekg(start)) {
+        std::cout << "Pattern table has the wrong size: " << path << '\n';
+        return {};
+    }
+
+    PatternTable table;
+    table.slots.resize(num_slots);
+    table.num_patterns = static_cast<int>(num_patterns);
+    if (!file.read(reinterpret_cast<char*>(table.slots.data()), num_slots * sizeof(Slot))) {
+        std::cout << "Pattern table is cut short: " << path << '\n';
+        return {};
+    }
+
+    // lookup() stops at an empty slot, so a table without one would make it loop forever
+    auto const num_used = std::count_if(
+        table.slots.begin(), table.slots.end(), [](Slot const& slot) { return slot.pattern != empty_slot; });
+    if (num_used != static_cast<std::ptrdiff_t>(num_patterns)) {
+        std::cout << "Pattern table doesn't hold what it says: " << path << '\n';
+        return {};
+    }
+    return table;
+}
+
+bool PatternTable::save(std::string const& path) const {
+    std::ofstream file{ path, std::ios::binary };
+    std::array<std::uint32_t, 4> const header{
+        file_magic, file_version, static_cast<std::uint32_t>(slots.size()), static_cast<std::uint32_t>(num_patterns) };
+    file.write(reinterpret_cast<char const*>(header.data()), sizeof(header));
+    file.write(reinterpret_cast<char const*>(slots.data()), slots.size() * sizeof(Slot));
+    return static_cast<bool>(file);
+}
+
+namespace {
+std::shared_ptr<PatternTable const> current_pattern_table = std::make_shared<PatternTable const>();
+} // end anonymous namespace
+
+std::shared_ptr<PatternTable const> pattern_table() {
+    return std::atomic_load(&current_pattern_table);
+}
+
+void set_pattern_table(std::shared_ptr<PatternTable const> table) {
+    std::atomic_store(&current_pattern_table, std::move(table));
+}
+
+bool find_pattern_moves(ConstraintGraph const& graph, PatternTable const& table, board_state_result& result) {
+    TRACE_SCOPE("pattern table");
+    result.safest_positions.clear();
+    result.unsafest_positions.clear();
+    result.num_solutions = 0;
+    result.win_probability.reset();
+    result.complete = true;
+    if (table.empty()) {
+        return false;
+    }
+
+    auto const board_order = [](Pos const& lhs, Pos const& rhs) {
+        return lhs.y != rhs.y ? lhs.y < rhs.y : lhs.x < rhs.x;
+    };
+    auto const add = [](std::vector<Pos>& positions, Pos pos) {
+        if (std::find(positions.begin(), positions.end(), pos) == positions.end()) {
+            positions.push_back(pos);
+        }
+    };
+
+    // Constraints are numbered in board order, and so are their partners at any one offset. So the partners are
+    // found by walking one cursor per orientation through the constraints, alongside the first number.
+    std::array<int, pair_offsets.size()> cursors{};
+    for (int first = 0; first < graph.num_constraints(); ++first) {
+        Pos const first_pos = graph.constraint_pos[first];
+        for (int orientation = 0; orientation < static_cast<int>(pair_offsets.size()); ++orientation) {
+            Pos const second_pos{ first_pos.x + pair_offsets[orientation][0], first_pos.y + pair_offsets[orientation][1] };
+            int& second = cursors[orientation];
+            while (second < graph.num_constraints() && board_order(graph.constraint_pos[second], second_pos)) {
+                ++second;
+            }
+            if (second == graph.num_constraints() || !(graph.constraint_pos[second] == second_pos)) {
+                continue;
+            }
+
+            Window const& window = windows()[orientation];
+            std::uint32_t covered = 0;
+            for (int constraint : { first, second }) {
+                for (int var : graph.variables_of(constraint)) {
+                    Pos const& pos = graph.variable_pos[var];
+                    covered |= 1u << window.index_of[(pos.y - first_pos.y + 2) * grid_size + pos.x - first_pos.x + 2];
+                }
+            }
+
+            std::optional<PatternTable::Deduction> const deduction = table.lookup(pattern_key(
+                orientation, covered, graph.constraint_remaining[first], graph.constraint_remaining[second]));
+            if (!deduction) {
+                continue;
+            }
+            for (int i = 0; i < window.num_cells; ++i) {
+                Pos const pos{ first_pos.x + window.cells[i].x, first_pos.y + window.cells[i].y };
+                if ((deduction->safe >> i) & 1) {
+                    add(result.safest_positions, pos);
+                }
+                if ((deduction->bombs >> i) & 1) {
+                    add(result.unsafest_positions, pos);
+                }
+            }
+        }
+    }
+
+    result.safe_certainty = 1;
+    result.unsafe_certainty = result.unsafest_positions.empty() ? .5 : 1;
+    return !result.safest_positions.empty();
+}
+
+} // namespace solver
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "constraint_graph.h"
+
+#include "../lib/util.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace solver {
+
+struct board_state_result;
+
+/*
+* Deductions for every local pattern of two adjacent numbers, precomputed by the winmine_gen_patterns tool.
+* A pattern is the window around two exposed numbers next to each other (sideways, up-down or diagonal):
+* which cells of the window are covered, and the two numbers. Each pattern that forces some of its covered
+* cells to be safe or bombs is stored in an open addressing hash table, so a lookup is O(1).
+* Since the window only holds two of the numbers on the board, everything it forces is forced on the whole board.
+*/
+class PatternTable {
+public:
+    struct Deduction {
+        std::uint16_t safe = 0;  // window cells that are never bombs
+        std::uint16_t bombs = 0; // window cells that are always bombs
+    };
+
+    // A table that knows no patterns
+    PatternTable() = default;
+
+    // Read a table written by save(). Nothing if the file is missing or not a pattern table.
+    static std::optional<PatternTable> load(std::string const& path);
+    bool save(std::string const& path) const;
+
+    std::optional<Deduction> lookup(std::uint32_t pattern) const;
+    int size() const { return num_patterns; }
+    bool empty() const { return num_patterns == 0; }
+
+    // Solve every pattern with the constraint solver, this takes a second or two
+    static PatternTable generate();
+
+private:
+    struct Slot {
+        std::uint32_t pattern;
+        Deduction deduction;
+    };
+    static constexpr std::uint32_t empty_slot = 0xFFFFFFFF;
+
+    std::vector<Slot> slots; // a power of two of them, at most half full
+    int num_patterns = 0;
+
+    void insert(std::uint32_t pattern, Deduction deduction);
+};
+
+// The table used by find_pattern_moves, empty until one is set. Safe to call from any thread.
+std::shared_ptr<PatternTable const> pattern_table();
+void set_pattern_table(std::shared_ptr<PatternTable const> table);
+
+/*
+* Look up every pair of adjacent numbers on the frontier of a compiled graph, without any search.
+* Returns true when that proves at least one covered cell safe. Then result.safest_positions holds all cells proven
+* safe, result.unsafest_positions all cells proven to be bombs, and num_solutions is 0 as nothing was counted.
+* Returns false when no pair proves anything safe, and the search has to decide.
+*/
+bool find_pattern_moves(ConstraintGraph const& graph, PatternTable const& table, board_state_result& result);
+
+} // namespace solver
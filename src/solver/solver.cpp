@@ -1,136 +1,289 @@
 #include "solver.h"
 
-#include "solver_helpers.h"
+#include "constraint_graph.h"
+#include "endgame_tree.h"
 
-#include "../control/controller.h"
 #include "../model/minefield.h"
+#include "../lib/trace.h"
 #include "../lib/util.h"
 
 #include <algorithm>
-#include <set>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <memory_resource>
 #include <string>
+#include <thread>
 
 using util::Pos;
 
 namespace { // Anonymous namespace
 
-void print_debug_solverfield(SolverField const& solverfield) {
-
-    std::cout << "--------";
-    for (int i = 0; i < solverfield.squares.size(); ++i) {
-        if (i % solverfield.max_width == 0) {
-            std::cout << '\n';
-        }
-        std::cout << "    " << std::to_string(solverfield.squares[i].bomb_count);
+using solver::ConstraintGraph;
+using solver::VarState;
+
+struct SearchState {
+    ConstraintGraph& graph;
+    std::pmr::vector<double>& bomb_count; // per variable, number of solutions where it is a bomb
+    int placed_bombs = 0;
+    int max_bombs = 0;
+
+    // Endgame only, indexed by placed_bombs: the number of ways to put the other mines on the interior cells,
+    // and how many bombs that puts on each interior cell summed over those ways. Null counts every solution once.
+    double const* leaf_weight = nullptr;
+    double const* interior_leaf_weight = nullptr;
+    double interior_bomb_count = 0; // per interior cell, summed over all solutions
+
+    // Cancellation and progress, only looked at when there is a control
+    solver::SearchControl* control = nullptr;
+    bool cancelled = false;
+    std::uint64_t num_nodes = 0;
+    double subtree_share = 1; // share of the whole search tree below the current node
+    double done_share = 0;    // share of the search tree that is finished
+};
+
+// n choose k, 0 when k is out of range
+double binomial(int n, int k) {
+    if (k < 0 || k > n) {
+        return 0;
     }
-    std::cout << '\n';
+    double result = 1;
+    for (int i = 1; i <= k; ++i) {
+        result = result * (n - k + i) / i;
+    }
+    return result;
+}
 
+// Natural log of n choose k, -infinity when k is out of range
+double log_binomial(int n, int k) {
+    if (k < 0 || k > n) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    return std::lgamma(n + 1.) - std::lgamma(k + 1.) - std::lgamma(n - k + 1.);
 }
 
 /*
-* Mark squares in input list as visited. Return list of squares that where not visited before.
+* Pick the constraint with the fewest ways to be satisfied among those that still have unknown variables, so
+* contradictions show up close to the root. A constraint that is already forced (all its unknowns must be safe,
+* or all must be bombs) goes first, otherwise the one with the fewest unknown variables.
+* Returns -1 when every variable is assigned.
 */
-std::vector<Square*> mark_squares_visited(std::vector<Square*> const& squares) {
-    std::vector<Square*> newly_visited;
-    for (Square* sq : squares) {
-        if (!sq->is_visited) {
-            newly_visited.push_back(sq);
+int most_constrained_open(ConstraintGraph const& graph) {
+    int best = -1;
+    int best_score = graph.num_variables() + 1;
+    for (int c = 0; c < graph.num_constraints(); ++c) {
+        int const remaining = graph.constraint_remaining[c];
+        int const unknown = graph.constraint_unknown[c];
+        if (unknown == 0) {
+            continue;
+        }
+        int const score = (remaining == 0 || remaining == unknown) ? 0 : unknown;
+        if (score < best_score) {
+            best = c;
+            best_score = score;
+            if (score == 0) {
+                break;
+            }
         }
-        sq->is_visited = true;
     }
-    return newly_visited;
+    return best;
 }
 
-void unmark_squares_visited(std::vector<Square*> const& squares) {
-    std::for_each(squares.begin(), squares.end(), [](Square* sq) {
-        sq->is_visited = false;
-        });
-}
+double count_possible_bomb_locations(SearchState& search);
 
-int count_bombs(std::vector<Square*> const& squares) {
-    return std::count_if(squares.begin(), squares.end(), [](Square const* square) {
-        return square->is_bomb;
-        });
+/*
+* Give one variable a value, count the solutions below that, and undo the assignment.
+* The assignment is forward checked against every constraint around the variable, and against the total number
+* of mines, so the branch is dropped as soon as any number can no longer be satisfied.
+*/
+double count_with_assignment(SearchState& search, int var, VarState state) {
+    ConstraintGraph& graph = search.graph;
+
+    graph.assign(var, state);
+    search.placed_bombs += state == VarState::Bomb;
+    double const share = search.subtree_share;
+    search.subtree_share = share / 2;
+
+    double num_solutions = 0;
+    if (search.placed_bombs <= search.max_bombs && graph.is_satisfiable_around(var)) {
+        num_solutions = count_possible_bomb_locations(search);
+    }
+    else {
+        search.done_share += search.subtree_share;
+    }
+    search.subtree_share = share;
+
+    if (state == VarState::Bomb) {
+        search.bomb_count[var] += num_solutions;
+        --search.placed_bombs;
+    }
+    graph.unassign(var);
+
+    return num_solutions;
 }
 
 /*
-* visit the square at position at the to of the exposed_squares input.
-* For that position, satisfy the bomb-count by placing bombs on adjacent uncovered squares, in every possible permutation.
-* When the bomb-count is satisfied, pop the current square from the exposed_squares stack, and recursively move on to the next.
-* When the exposed_squares stack is empty, we have found a possible "solution", one variation of how bombs can be placed to
-* satisfy all the conditions.
-* When we have found a working solution, add 1 to all the squares that where marked as bombs in that solution.
+* Count every distinct way of placing bombs on the variables that satisfies all constraints, visiting each one
+* exactly once. Each node picks the most constrained open constraint and either
+* - assigns all its unknown variables at once when their value is forced, or
+* - branches on its first unknown variable, bomb or safe.
+* Since every branch decides one variable two different ways, no configuration can be reached along two paths.
+* When we have found a working solution, add 1 to all the variables that where marked as bombs in that solution.
+* Counts are doubles as they grow exponentially with the width of the frontier.
 */
-int count_possible_bomb_locations(SolverField& solverfield, std::vector<Pos> exposed_squares, Minefield const& minefield) {
+double count_possible_bomb_locations(SearchState& search) {
+    ConstraintGraph& graph = search.graph;
 
-    // We have evaluated all exposed squares correctly, this is a valid solution
-    if (exposed_squares.empty()) {
-        return 1;
+    if (search.control != nullptr && ++search.num_nodes % solver::SearchControl::check_interval == 0) {
+        search.cancelled = search.control->check(search.num_nodes);
+        search.control->set_progress(search.done_share);
+    }
+    if (search.cancelled) {
+        return 0;
     }
 
-    Pos pos = exposed_squares.back();
-    std::vector<Square*> adjacent_squares = solverfield.get_adjacent_covered_squares(pos, minefield);
-    Cell const& actual_cell = minefield.get_cell(pos);
+    int const constraint = most_constrained_open(graph);
 
-    auto goto_next_square = [
-        &exposed_squares,
-            &adjacent_squares,
-            &solverfield,
-            &minefield,
-            pos]() {
-        exposed_squares.pop_back();
-        std::vector<Square*> marked_squares = mark_squares_visited(adjacent_squares);
+    // Every variable is assigned, and forward checking kept all constraints satisfiable, so this is a solution
+    if (constraint < 0) {
+        search.done_share += search.subtree_share;
+        if (search.leaf_weight == nullptr) {
+            return 1;
+        }
+        search.interior_bomb_count += search.interior_leaf_weight[search.placed_bombs];
+        return search.leaf_weight[search.placed_bombs];
+    }
 
-        int tot_num_solutions = count_possible_bomb_locations(solverfield, exposed_squares, minefield);
+    int const remaining = graph.constraint_remaining[constraint];
+    int const unknown = graph.constraint_unknown[constraint];
 
-        unmark_squares_visited(marked_squares);
-        exposed_squares.push_back(pos);
+    if (remaining == 0 || remaining == unknown) {
+        VarState const forced = remaining == 0 ? VarState::Safe : VarState::Bomb;
 
-        return tot_num_solutions;
-    };
+        std::array<int, 8> assigned;
+        int num_assigned = 0;
+        bool satisfiable = true;
+        for (int var : graph.variables_of(constraint)) {
+            if (graph.variable_state[var] == VarState::Unknown) {
+                graph.assign(var, forced);
+                assigned[num_assigned++] = var;
+                satisfiable = satisfiable && graph.is_satisfiable_around(var);
+            }
+        }
+        if (forced == VarState::Bomb) {
+            search.placed_bombs += num_assigned;
+        }
+
+        double num_solutions = 0;
+        if (satisfiable && search.placed_bombs <= search.max_bombs) {
+            num_solutions = count_possible_bomb_locations(search);
+        }
+        else {
+            search.done_share += search.subtree_share;
+        }
 
-    int num_bombs_to_place = actual_cell.get_num_adjacent_bombs() - count_bombs(adjacent_squares);
-
-    if (num_bombs_to_place < 0) {
-        return 0; // Too many adjacent bombs, this is not a valid solution
-    }
-    else if (num_bombs_to_place == 0) { // Criterion already satisfied, just go on with the list
-        return goto_next_square();
-    }
-    else { // Need to place 1 or more bombs for the criterion to be satisfied
-        if (solverfield.placed_bombs == minefield.get_num_mines()) {
-            // Can't place more, already at quota, this is not a solution
-            return 0;
-        }
-
-        int tot_num_solutions = 0;
-        for (Square* adj_sq_ptr : adjacent_squares) {
-            Square& adj_sq = *adj_sq_ptr;
-            if (!adj_sq.is_visited
-                && !adj_sq.is_bomb
-                && !minefield.get_cell(adj_sq.pos).is_exposed()) {
-                adj_sq.is_bomb = true;
-                ++solverfield.placed_bombs;
-
-                if (num_bombs_to_place == 1) { // This square is satisfied
-                    int num_solutions = goto_next_square();
-                    adj_sq.bomb_count += num_solutions;
-                    tot_num_solutions += num_solutions;
-                }
-                else { // Not enough adjacent bombs for this square, need to place more
-                    int num_solutions = count_possible_bomb_locations(solverfield, exposed_squares, minefield);
-                    adj_sq.bomb_count += num_solutions;
-                    tot_num_solutions += num_solutions;
-                }
-
-                adj_sq.is_bomb = false;
-                --solverfield.placed_bombs;
+        if (forced == VarState::Bomb) {
+            search.placed_bombs -= num_assigned;
+        }
+        for (int i = 0; i < num_assigned; ++i) {
+            if (forced == VarState::Bomb) {
+                search.bomb_count[assigned[i]] += num_solutions;
             }
+            graph.unassign(assigned[i]);
+        }
+        return num_solutions;
+    }
+
+    for (int var : graph.variables_of(constraint)) {
+        if (graph.variable_state[var] == VarState::Unknown) {
+            return count_with_assignment(search, var, VarState::Bomb)
+                + count_with_assignment(search, var, VarState::Safe);
+        }
+    }
+
+    return 0; // unreachable, an open constraint has an unknown variable
+}
+
+/*
+* Fill in result from the number of solutions where each cell is a bomb.
+* The safest and unsafest positions are picked among all cells in the list.
+*/
+void fill_result(std::pmr::vector<util::Pos> const& positions, std::pmr::vector<double> const& bomb_count,
+    double total_num_solutions, solver::board_state_result& result) {
+
+    result.safest_positions.clear();
+    result.unsafest_positions.clear();
+    result.num_solutions = total_num_solutions;
+    result.win_probability.reset();
+    result.complete = true;
+
+    if (positions.empty()) {
+        result.safe_certainty = .5;
+        result.unsafe_certainty = .5;
+        return;
+    }
+
+    auto const [min, max] = std::minmax_element(bomb_count.begin(), bomb_count.end());
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        if (bomb_count[i] == *min) {
+            result.safest_positions.push_back(positions[i]);
+        }
+        if (bomb_count[i] == *max) {
+            result.unsafest_positions.push_back(positions[i]);
+        }
+    }
+    result.safe_certainty = 1 - *min / total_num_solutions;
+    result.unsafe_certainty = *max / total_num_solutions;
+}
+
+/*
+* The one thread find_next_moves_async runs its searches on, one at a time in the order they came. It lives as
+* long as the program, so its arena and trace buffer are made once, rather than once per move.
+*/
+class SearchThread {
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+
+    void run() {
+        TRACE_THREAD_NAME("search");
+        std::unique_lock<std::mutex> lock{ mutex };
+        while (true) {
+            work_ready.wait(lock, [this]() { return !tasks.empty(); });
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+public:
+    SearchThread()
+        : thread{ [this]() { run(); } }
+    {}
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            tasks.push_back(std::move(task));
         }
-        return tot_num_solutions;
+        work_ready.notify_one();
     }
+};
 
-    return 0;
+// Never destroyed: the thread still sleeps in run() at exit, while the statics it records into go away
+SearchThread& search_thread() {
+    static SearchThread* const instance = new SearchThread;
+    return *instance;
 }
 
 } // End anonymous namespace
@@ -138,71 +291,291 @@ int count_possible_bomb_locations(SolverField& solverfield, std::vector<Pos> exp
 namespace solver {
 
 std::vector<Pos> find_best_moves(Minefield const& minefield) {
-    return explore_possible_minefield_states(minefield).safest_positions;
+    std::shared_ptr<BoardAnalysis const> const analysis = analyze(minefield);
+
+    std::vector<Pos> best;
+    double min_probability = 1;
+    for (Pos const& pos : analysis->frontier) {
+        double const probability = analysis->probability_at(pos);
+        if (probability < min_probability) {
+            best.clear();
+            min_probability = probability;
+        }
+        if (probability == min_probability) {
+            best.push_back(pos);
+        }
+    }
+    return best;
 }
 
 std::vector<util::Pos> find_bombs(Minefield const& minefield) {
-    board_state_result result = explore_possible_minefield_states(minefield);
-    if (result.unsafe_certainty > .99) { // mark it as bomb if we are 99% certain
-        return result.unsafest_positions;
+    std::shared_ptr<BoardAnalysis const> const analysis = analyze(minefield);
+
+    std::vector<Pos> bombs;
+    double max_probability = .99; // mark it as bomb if we are 99% certain
+    for (Pos const& pos : analysis->frontier) {
+        double const probability = analysis->probability_at(pos);
+        if (probability > max_probability) {
+            bombs.clear();
+            max_probability = probability;
+        }
+        if (probability == max_probability) {
+            bombs.push_back(pos);
+        }
     }
-    return {};
+    return bombs;
 }
 
 /*
-Explore all possible bomb placements, and return a structure with information about
-best and worst possible moves.
+* One weighted search over the frontier, as in solve_endgame_graph. The weights are binomials that overflow a
+* double on big boards, so they are all divided by the largest one, which the probabilities don't care about.
 */
-board_state_result explore_possible_minefield_states(Minefield const& minefield) {
-    SolverField solverfield{ minefield.get_width(), minefield.get_height() };
-    std::vector<Pos> exposed_squares;
-
-    for (int y = 0; y < minefield.get_height(); ++y) {
-        for (int x = 0; x < minefield.get_width(); ++x) {
-            Pos pos{ x, y };
-            if (minefield.get_cell(pos).is_exposed() && minefield.get_cell(pos).get_num_adjacent_bombs() > 0) {
-                exposed_squares.push_back(pos);
-            }
+double solve_mine_probabilities(ConstraintGraph& graph, int num_mines, int width, util::Arena& arena, double* mine_probability) {
+    TRACE_SCOPE("solve mine probabilities");
+    int const num_interior = static_cast<int>(graph.interior_pos.size());
+
+    double log_scale = -std::numeric_limits<double>::infinity();
+    for (int k = 0; k <= num_mines; ++k) {
+        log_scale = std::max(log_scale, log_binomial(num_interior, num_mines - k));
+    }
+    std::pmr::vector<double> leaf_weight(num_mines + 1, 0., &arena);
+    std::pmr::vector<double> interior_leaf_weight(num_mines + 1, 0., &arena);
+    for (int k = 0; k <= num_mines; ++k) {
+        leaf_weight[k] = std::exp(log_binomial(num_interior, num_mines - k) - log_scale);
+        interior_leaf_weight[k] = std::exp(log_binomial(num_interior - 1, num_mines - k - 1) - log_scale);
+    }
+
+    std::pmr::vector<double> bomb_count(graph.num_variables(), 0., &arena);
+    SearchState search{ graph, bomb_count, 0, num_mines, leaf_weight.data(), interior_leaf_weight.data() };
+    double const total_num_solutions = count_possible_bomb_locations(search);
+
+    auto set_probability = [&](Pos const& pos, double bomb_count) {
+        mine_probability[pos.y * width + pos.x] = total_num_solutions > 0 ? bomb_count / total_num_solutions : 0;
+    };
+    for (int v = 0; v < graph.num_variables(); ++v) {
+        set_probability(graph.variable_pos[v], bomb_count[v]);
+    }
+    for (Pos const& pos : graph.interior_pos) {
+        set_probability(pos, search.interior_bomb_count);
+    }
+    return total_num_solutions * std::exp(log_scale);
+}
+
+std::shared_ptr<BoardAnalysis const> analyze(Minefield const& minefield) {
+    TRACE_SCOPE("analyze");
+    thread_local util::Arena arena;
+    arena.reset();
+
+    ConstraintGraph graph{ &arena };
+    compile_constraint_graph(minefield, graph);
+
+    auto analysis = std::make_shared<BoardAnalysis>();
+    analysis->width = minefield.get_width();
+    analysis->height = minefield.get_height();
+    analysis->mine_probability.assign(analysis->width * analysis->height, 0.);
+    analysis->frontier.assign(graph.variable_pos.begin(), graph.variable_pos.end());
+    analysis->num_solutions = solve_mine_probabilities(graph, minefield.get_num_mines(), analysis->width, arena,
+        analysis->mine_probability.data());
+
+    auto classify = [&](Pos const& pos) {
+        double const probability = analysis->probability_at(pos);
+        if (analysis->num_solutions == 0) {
+            return;
+        }
+        if (probability == 0) {
+            analysis->forced_safe.push_back(pos);
         }
+        else if (probability > 1 - 1e-9) { // the same sum, added up in another order
+            analysis->forced_mines.push_back(pos);
+        }
+    };
+    std::for_each(graph.variable_pos.begin(), graph.variable_pos.end(), classify);
+    std::for_each(graph.interior_pos.begin(), graph.interior_pos.end(), classify);
+
+    return analysis;
+}
+
+board_state_result explore_possible_minefield_states(Minefield const& minefield) {
+    thread_local util::Arena arena;
+    board_state_result result;
+    explore_possible_minefield_states(minefield, arena, result);
+    return result;
+}
+
+/*
+Explore all possible bomb placements, and fill in a structure with information about
+best and worst possible moves.
+*/
+void explore_possible_minefield_states(Minefield const& minefield, util::Arena& arena, board_state_result& result) {
+    arena.reset();
+
+    ConstraintGraph graph{ &arena };
+    compile_constraint_graph(minefield, graph);
+    solve_constraint_graph(graph, minefield.get_num_mines(), arena, result);
+}
+
+void solve_constraint_graph(ConstraintGraph& graph, int num_mines, util::Arena& arena, board_state_result& result,
+    SearchControl* control) {
+
+    TRACE_SCOPE("solve constraint graph");
+    std::pmr::vector<double> bomb_count(graph.num_variables(), 0., &arena);
+
+    SearchState search{ graph, bomb_count, 0, num_mines };
+    search.control = control;
+    double const total_num_solutions = count_possible_bomb_locations(search);
+    if (control != nullptr) {
+        control->add_nodes(search.num_nodes);
     }
 
-    int total_num_solutions = count_possible_bomb_locations(solverfield, exposed_squares, minefield);
+    // only variables, the squares adjacent to exposed numbers, are relevant
+    fill_result(graph.variable_pos, bomb_count, total_num_solutions, result);
+    result.complete = !search.cancelled;
+}
+
+board_state_result find_next_moves(Minefield const& minefield) {
+    thread_local util::Arena arena;
+    board_state_result result;
+    find_next_moves(minefield, arena, result);
+    return result;
+}
+
+bool is_endgame(int num_covered_cells, int num_mines) {
+    return num_covered_cells <= endgame_max_covered_cells || num_mines <= endgame_max_mines;
+}
+
+board_state_result explore_endgame_states(Minefield const& minefield, bool search_game_tree) {
+    thread_local util::Arena arena;
+    board_state_result result;
+    explore_endgame_states(minefield, arena, result, search_game_tree);
+    return result;
+}
+
+void explore_endgame_states(Minefield const& minefield, util::Arena& arena, board_state_result& result, bool search_game_tree) {
+    arena.reset();
 
-    std::set<Square*> possible_bomb_squares; // only squares that are adjacent to exposed numbers are relevant
-                                             // std::set to avoid duplicated squares.
-    for (Pos const& pos : exposed_squares) {
-        std::vector<Square*> adj_squares = solverfield.get_adjacent_covered_squares(pos, minefield);
-        possible_bomb_squares.insert(adj_squares.begin(), adj_squares.end());
+    ConstraintGraph graph{ &arena };
+    compile_constraint_graph(minefield, graph);
+    solve_endgame_graph(graph, minefield.get_num_mines(), arena, result, search_game_tree);
+}
+
+/*
+* Every full bomb placement is a solution on the frontier, plus some choice of interior cells for the mines that
+* are left. A frontier solution with k bombs therefore stands for C(interior, mines - k) placements, which is
+* the weight it gets at its leaf of the search. Each interior cell is a bomb in C(interior - 1, mines - k - 1)
+* of those.
+*/
+void solve_endgame_graph(ConstraintGraph& graph, int num_mines, util::Arena& arena, board_state_result& result, bool search_game_tree,
+    SearchControl* control) {
+
+    TRACE_SCOPE("solve endgame");
+    int const num_interior = static_cast<int>(graph.interior_pos.size());
+
+    std::pmr::vector<double> leaf_weight(num_mines + 1, 0., &arena);
+    std::pmr::vector<double> interior_leaf_weight(num_mines + 1, 0., &arena);
+    for (int k = 0; k <= num_mines; ++k) {
+        leaf_weight[k] = binomial(num_interior, num_mines - k);
+        interior_leaf_weight[k] = binomial(num_interior - 1, num_mines - k - 1);
     }
 
-    auto const [min, max] = std::minmax_element(possible_bomb_squares.begin(), possible_bomb_squares.end(),
-        [](Square const* lhs, Square const* rhs) {
-            return lhs->bomb_count < rhs->bomb_count;
-        });
+    std::pmr::vector<double> bomb_count(graph.num_variables(), 0., &arena);
+    SearchState search{ graph, bomb_count, 0, num_mines, leaf_weight.data(), interior_leaf_weight.data() };
+    search.control = control;
+    double const total_num_solutions = count_possible_bomb_locations(search);
+    if (control != nullptr) {
+        control->add_nodes(search.num_nodes);
+    }
 
-    std::vector<Pos> safe_squares, unsafe_squares;
-    for (Square const* sq : possible_bomb_squares) {
-        if (sq->bomb_count == (*min)->bomb_count) {
-            safe_squares.push_back(sq->pos);
+    // All covered cells take part, the frontier first
+    std::pmr::vector<util::Pos> positions{ graph.variable_pos.begin(), graph.variable_pos.end(), &arena };
+    positions.insert(positions.end(), graph.interior_pos.begin(), graph.interior_pos.end());
+    bomb_count.resize(positions.size(), search.interior_bomb_count);
+
+    fill_result(positions, bomb_count, total_num_solutions, result);
+    if (search.cancelled) {
+        result.complete = false;
+        return;
+    }
+
+    // With no safe cell left, play the move that wins most often rather than the one that survives most often
+    bool const must_guess = !positions.empty() && result.safe_certainty < 1;
+    if (search_game_tree && must_guess && static_cast<int>(positions.size()) <= endgame_tree_max_cells) {
+        TRACE_SCOPE("endgame game tree");
+        if (std::optional<EndgameMove> const move = search_endgame_tree(graph, num_mines, arena, control)) {
+            result.safest_positions.assign(1, move->pos);
+            result.safe_certainty = move->safe_probability;
+            result.win_probability = move->win_probability;
         }
-        if (sq->bomb_count == (*max)->bomb_count) {
-            unsafe_squares.push_back(sq->pos);
+        else if (control != nullptr && control->is_cancelled()) {
+            result.complete = false; // the move is the safest one, not the one the finished tree would pick
         }
     }
+}
 
-    double safe_certainty = possible_bomb_squares.empty() ?
-        .5 :
-        1 - (*min)->bomb_count / static_cast<double>(total_num_solutions);
-    double unsafe_certainty = possible_bomb_squares.empty() ?
-        .5 : (*max)->bomb_count / static_cast<double>(total_num_solutions);
+AsyncSearch::AsyncSearch(std::shared_ptr<SearchControl> control, std::future<board_state_result> future)
+    : control{ std::move(control) }
+    , future{ std::move(future) }
+{}
 
+AsyncSearch& AsyncSearch::operator=(AsyncSearch&& other) {
+    if (this != &other) {
+        drop();
+        control = std::move(other.control);
+        future = std::move(other.future);
+    }
+    return *this;
+}
 
-    return board_state_result{
-        /*.safest_positions = */safe_squares,
-        /*.unsafest_positions = */unsafe_squares,
-        /*.safe_certainty = */safe_certainty,
-        /*.unsafe_certainty = */ unsafe_certainty
-    };
+AsyncSearch::~AsyncSearch() {
+    drop();
+}
+
+void AsyncSearch::drop() {
+    if (control) {
+        control->cancel();
+    }
+    if (future.valid()) {
+        future.wait();
+    }
+}
+
+bool AsyncSearch::is_ready() const {
+    return future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+}
+
+board_state_result AsyncSearch::get() {
+    return future.get();
+}
+
+AsyncSearch find_next_moves_async(std::shared_ptr<Minefield const> board, std::function<void()> on_done) {
+    auto control = std::make_shared<SearchControl>();
+    auto promise = std::make_shared<std::promise<board_state_result>>();
+    std::future<board_state_result> future = promise->get_future();
+    search_thread().post([board, control, on_done, promise]() {
+        TRACE_SCOPE("async search");
+        thread_local util::Arena arena;
+        board_state_result result;
+        std::exception_ptr error;
+        try {
+            find_next_moves(*board, arena, result, control.get());
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        if (!error && result.complete) {
+            control->set_progress(1);
+        }
+        // Also when it failed, the caller waits for this to come and collect the future
+        if (on_done) {
+            on_done();
+        }
+        if (error) {
+            promise->set_exception(error);
+        }
+        else {
+            promise->set_value(std::move(result));
+        }
+        });
+    return { std::move(control), std::move(future) };
 }
 
-} // namespace Solver
\ No newline at end of file
+} // namespace Solver
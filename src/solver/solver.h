@@ -1,10 +1,24 @@
 #pragma once
 
+#include "constraint_graph.h"
+#include "pattern_table.h"
+
+#include "../lib/arena.h"
 #include "../lib/util.h"
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
 // Forward declarations
 class Controller;
 class Minefield;
+template<int Width, int Height> class FixedMinefield;
 
 namespace solver {
 
@@ -14,12 +28,200 @@ struct board_state_result {
 
 	double safe_certainty = .5;   // 0-100%, 0% means definitely a bomb, 100% means definitely safe
 	double unsafe_certainty = .5;   // 0-100%, 0% means definitely safe, 100% means definitely a bomb
+
+	double num_solutions = 0; // distinct bomb placements around the exposed numbers that fit what is shown
+
+	// Set by the endgame game tree search: chance to win the game when playing safest_positions from here on
+	std::optional<double> win_probability;
+
+	// False when the search was cancelled. The counts then only cover the part that was searched.
+	bool complete = true;
 };
 
+/*
+* Lets another thread stop a search, and see how far it got. The search looks at it every so many nodes, and
+* then returns with what it has counted so far.
+*/
+class SearchControl {
+	std::atomic<bool> cancelled{ false };
+	std::atomic<double> progress{ 0 };
+	std::atomic<std::uint64_t> num_nodes{ 0 };
+	std::atomic<std::uint64_t> node_limit{ std::numeric_limits<std::uint64_t>::max() };
+
+public:
+	// Nodes between two looks at the control
+	static constexpr unsigned check_interval = 1024;
+
+	void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+	bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+	// Nodes one search may visit, counted from its start, before it cancels the control. No limit by default.
+	void set_node_limit(std::uint64_t limit) { node_limit.store(limit, std::memory_order_relaxed); }
+
+	// The look a search takes every check_interval nodes, with the nodes it has visited: true when it has to stop
+	bool check(std::uint64_t num_nodes_so_far) {
+		if (num_nodes_so_far >= node_limit.load(std::memory_order_relaxed)) {
+			cancel();
+		}
+		return is_cancelled();
+	}
+
+	// Estimated fraction of the search done, from 0 to 1. Every branch counts as half of its parent.
+	double get_progress() const { return progress.load(std::memory_order_relaxed); }
+	void set_progress(double done) { progress.store(done, std::memory_order_relaxed); }
+
+	// Nodes visited by the searches run with this control, added when each of them returns
+	std::uint64_t get_num_nodes() const { return num_nodes.load(std::memory_order_relaxed); }
+	void add_nodes(std::uint64_t count) { num_nodes.fetch_add(count, std::memory_order_relaxed); }
+};
+
+// Boards with at most this many covered cells, or at most this many mines, are played as an endgame
+constexpr int endgame_max_covered_cells = 40;
+constexpr int endgame_max_mines = 8;
+// Endgames with at most this many covered cells are searched move by move, to maximize the chance to win
+constexpr int endgame_tree_max_cells = 16;
+
 board_state_result explore_possible_minefield_states(Minefield const& minefield);
 
+// Same as above, but takes all scratch memory from the arena (which is reset first), and reuses
+// the capacity already in result. Once warmed up on a position, this does not allocate.
+void explore_possible_minefield_states(Minefield const& minefield, util::Arena& arena, board_state_result& result);
+
+// Count the solutions of a compiled graph with at most num_mines bombs, and fill in result from them.
+// graph must have been compiled into arena, all other scratch memory comes from there too.
+// With a control, the search can be cancelled from another thread and reports its progress there.
+void solve_constraint_graph(ConstraintGraph& graph, int num_mines, util::Arena& arena, board_state_result& result,
+	SearchControl* control = nullptr);
+
+// Same as for a Minefield, on a board whose size is fixed at compile time
+template<int Width, int Height>
+void explore_possible_minefield_states(FixedMinefield<Width, Height> const& minefield, util::Arena& arena, board_state_result& result) {
+	arena.reset();
+
+	ConstraintGraph graph{ &arena };
+	compile_constraint_graph(minefield, graph);
+	solve_constraint_graph(graph, minefield.get_num_mines(), arena, result);
+}
+
+bool is_endgame(int num_covered_cells, int num_mines);
+
+template<typename Board>
+bool is_endgame(Board const& board) {
+	return is_endgame(board.get_width() * board.get_height() - board.count_exposed_cells(), board.get_num_mines());
+}
+
+/*
+* Exact solver for the end of the game. Unlike explore_possible_minefield_states, every covered cell is a
+* candidate and the mine count has to match exactly, so num_solutions counts full bomb placements and the
+* certainties are the true odds. When no cell is safe and few enough are covered, and search_game_tree is set,
+* the whole game tree is searched, and safest_positions is the single move with the best chance to win.
+*/
+board_state_result explore_endgame_states(Minefield const& minefield, bool search_game_tree = true);
+
+void explore_endgame_states(Minefield const& minefield, util::Arena& arena, board_state_result& result, bool search_game_tree = true);
+
+// Same as solve_constraint_graph, for the endgame. A cancelled search skips the game tree, or stops it part way.
+void solve_endgame_graph(ConstraintGraph& graph, int num_mines, util::Arena& arena, board_state_result& result, bool search_game_tree,
+	SearchControl* control = nullptr);
+
+template<int Width, int Height>
+void explore_endgame_states(FixedMinefield<Width, Height> const& minefield, util::Arena& arena, board_state_result& result, bool search_game_tree = true) {
+	arena.reset();
+
+	ConstraintGraph graph{ &arena };
+	compile_constraint_graph(minefield, graph);
+	solve_endgame_graph(graph, minefield.get_num_mines(), arena, result, search_game_tree);
+}
+
+/*
+* What to play next, the cheapest way that is still right: the pattern table when it proves a cell safe, the
+* endgame solver near the end of the game, and explore_possible_minefield_states otherwise.
+* Board is Minefield or a FixedMinefield.
+*/
+template<typename Board>
+void find_next_moves(Board const& board, util::Arena& arena, board_state_result& result, SearchControl* control = nullptr) {
+	arena.reset();
+
+	ConstraintGraph graph{ &arena };
+	compile_constraint_graph(board, graph);
+	if (find_pattern_moves(graph, *pattern_table(), result)) {
+		return;
+	}
+	if (is_endgame(board)) {
+		solve_endgame_graph(graph, board.get_num_mines(), arena, result, true, control);
+	}
+	else {
+		solve_constraint_graph(graph, board.get_num_mines(), arena, result, control);
+	}
+}
+
+board_state_result find_next_moves(Minefield const& minefield);
+
+/*
+* Handle to find_next_moves running on the search thread. Dropping the handle cancels the search, and waits for
+* it to notice, which takes no longer than SearchControl::check_interval nodes, once the searches queued before
+* it are done.
+*/
+class AsyncSearch {
+	std::shared_ptr<SearchControl> control;
+	std::future<board_state_result> future;
+
+	// Cancel the search, and wait for it to notice
+	void drop();
+
+public:
+	AsyncSearch(std::shared_ptr<SearchControl> control, std::future<board_state_result> future);
+	AsyncSearch(AsyncSearch&&) = default;
+	AsyncSearch& operator=(AsyncSearch&& other);
+	~AsyncSearch();
+
+	void cancel() { control->cancel(); }
+	double get_progress() const { return control->get_progress(); }
+	std::shared_ptr<SearchControl const> get_control() const { return control; }
+
+	bool is_ready() const;
+	// Waits for the search. When it was cancelled, the result is partial, see board_state_result::complete.
+	// Throws what the search threw.
+	board_state_result get();
+};
+
+// Queue find_next_moves on the search thread, one thread for the whole program that runs the searches one at a
+// time. on_done, if given, is called from that thread when the search is over, right before the result, or what
+// the search threw, is handed to the future.
+AsyncSearch find_next_moves_async(std::shared_ptr<Minefield const> board, std::function<void()> on_done = {});
+
+/*
+* Everything one search knows about a board. Like the endgame solver, the mine count has to match exactly and
+* interior cells take part, so every covered cell gets its true chance to be a mine.
+*/
+struct BoardAnalysis {
+	int width = 0;
+	int height = 0;
+
+	std::vector<double> mine_probability; // per cell, index = y*width + x. 0 for exposed cells
+	std::vector<util::Pos> frontier;      // covered cells next to an exposed number
+	std::vector<util::Pos> forced_safe;   // covered cells that are a mine in no solution
+	std::vector<util::Pos> forced_mines;  // covered cells that are a mine in every solution
+
+	// Full bomb placements that fit what is shown. Only approximate once it gets too big to count exactly
+	double num_solutions = 0;
+
+	double probability_at(util::Pos pos) const { return mine_probability[pos.y * width + pos.x]; }
+};
+
+// The chance of every covered cell of a compiled graph to be a mine, with exactly num_mines on the board, written
+// to mine_probability[y * width + x]. Other cells are left as they are. Returns the number of full bomb
+// placements that fit, 0 when none do and all the chances are written as 0.
+double solve_mine_probabilities(ConstraintGraph& graph, int num_mines, int width, util::Arena& arena, double* mine_probability);
+
+// Analyse a board. It can't be cancelled, so it is for tools and tests, play goes through find_next_moves.
+// Any thread can call this on a board that isn't being changed at the same time, like a snapshot.
+std::shared_ptr<BoardAnalysis const> analyze(Minefield const& minefield);
+
+// The frontier cells least likely to be a mine, from analyze()
 std::vector<util::Pos> find_best_moves(Minefield const& minefield);
 
+// The frontier cells most likely to be a mine, from analyze(), if that is almost certain
 std::vector<util::Pos> find_bombs(Minefield const& minefield);
 
 } // namespace Solver
\ No newline at end of file
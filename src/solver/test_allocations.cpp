@@ -0,0 +1,39 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/*
+* Count every heap allocation in the test binary, so tests can assert that a code path doesn't allocate.
+* All forms of operator new and delete that end in malloc and free are replaced together, and they live in a file
+* of their own, so no compiler sees a free inlined into code that got its memory from operator new.
+*/
+std::atomic<std::size_t> num_heap_allocations{ 0 };
+
+void* operator new(std::size_t size) {
+	++num_heap_allocations;
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+	return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+	::operator delete(ptr);
+}
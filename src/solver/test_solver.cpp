@@ -1,16 +1,29 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
 
+#include "board_view.h"
 #include "solver.h"
-#include "solver_helpers.h"
+#include "winmine_solver.h"
 #include "../model/minefield.h"
 #include "../control/controller.h"
 #include "../lib/util.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
 #include <unordered_set>
 
 using util::Pos;
 
+// Every heap allocation of the test binary so far, counted in test_allocations.cpp
+extern std::atomic<std::size_t> num_heap_allocations;
+
 namespace std {
 template<> struct hash<Pos>
 {
@@ -58,6 +71,23 @@ std::unique_ptr<Controller> create_board(std::string const& board) {
 	return control;
 }
 
+// A board with num_mines mines in random places, and num_clicks other random cells exposed
+Minefield random_position(std::mt19937& rng, int width, int height, int num_mines, int num_clicks) {
+	std::vector<int> indices(width * height);
+	std::iota(indices.begin(), indices.end(), 0);
+	std::shuffle(indices.begin(), indices.end(), rng);
+	std::vector<Pos> mines;
+	for (int i = 0; i < num_mines; ++i) {
+		mines.emplace_back(indices[i] % width, indices[i] / width);
+	}
+
+	Minefield minefield{ width, height, mines };
+	for (int i = num_mines; i < num_mines + num_clicks; ++i) {
+		minefield.expose({ indices[i] % width, indices[i] / width });
+	}
+	return minefield;
+}
+
 template<typename T>
 std::unordered_set<T> to_set(std::vector<T> const& v) {
 	return std::unordered_set<T>{ v.cbegin(), v.cend() };
@@ -68,7 +98,7 @@ void test_moves_solver(std::string const& state_board, std::string const& expect
 
 	std::vector<Pos> expected_moves = find_char_positions('m', expected_moves_board);
 
-	std::vector<Pos> actual_moves = solver::find_best_moves(control->get_minefield());
+	std::vector<Pos> actual_moves = solver::find_best_moves(*control->snapshot());
 
 	REQUIRE(to_set(expected_moves) == to_set(actual_moves));
 }
@@ -154,4 +184,666 @@ mo.m
 m.om
 .mmm)");
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("Solver scratch memory", "[Arena]") {
+
+	std::unique_ptr<Controller> control = create_board(R"(
+.....
+.ob..
+..o..
+..bo.
+.....)");
+	std::shared_ptr<Minefield const> const snapshot = control->snapshot();
+	Minefield const& minefield = *snapshot;
+
+	util::Arena arena;
+	solver::board_state_result result;
+
+	// First round may grow the arena and the result vectors
+	solver::explore_possible_minefield_states(minefield, arena, result);
+	solver::board_state_result const first_result = result;
+
+	std::size_t const allocations_before = num_heap_allocations;
+	solver::explore_possible_minefield_states(minefield, arena, result);
+	REQUIRE(num_heap_allocations == allocations_before);
+
+	REQUIRE(to_set(result.safest_positions) == to_set(first_result.safest_positions));
+	REQUIRE(to_set(result.unsafest_positions) == to_set(first_result.unsafest_positions));
+}
+
+/*
+* Reference solver: try every bomb placement on the cells next to exposed numbers, and keep those that fit
+* all the numbers and the total mine count. Gives up on frontiers that are too wide to enumerate.
+*/
+std::optional<solver::board_state_result> brute_force_solve(Minefield const& minefield) {
+	int const width = minefield.get_width();
+	int const height = minefield.get_height();
+
+	std::vector<Pos> frontier;
+	std::vector<Pos> numbers;
+	for (auto const& [pos, cell] : minefield) {
+		std::vector<Pos> const adjacent = util::get_adjacent_positions(pos, width, height);
+		bool const next_to_number = std::any_of(adjacent.begin(), adjacent.end(), [&](Pos p) {
+			return minefield.get_cell(p).is_exposed() && minefield.get_cell(p).get_num_adjacent_bombs() > 0;
+			});
+		if (cell.is_covered() && next_to_number) {
+			frontier.push_back(pos);
+		}
+		if (cell.is_exposed() && cell.get_num_adjacent_bombs() > 0) {
+			numbers.push_back(pos);
+		}
+	}
+	if (frontier.size() > 20) {
+		return {};
+	}
+
+	double num_solutions = 0;
+	std::vector<double> bomb_count(frontier.size(), 0.);
+	for (unsigned mask = 0; mask < (1u << frontier.size()); ++mask) {
+		auto is_bomb = [&](Pos p) {
+			auto it = std::find(frontier.begin(), frontier.end(), p);
+			return it != frontier.end() && (mask >> (it - frontier.begin())) & 1;
+		};
+
+		int num_bombs = 0;
+		for (unsigned m = mask; m != 0; m >>= 1) {
+			num_bombs += m & 1;
+		}
+		bool fits = num_bombs <= minefield.get_num_mines();
+		for (Pos number : numbers) {
+			std::vector<Pos> const adjacent = util::get_adjacent_positions(number, width, height);
+			fits = fits && std::count_if(adjacent.begin(), adjacent.end(), is_bomb)
+				== minefield.get_cell(number).get_num_adjacent_bombs();
+		}
+		if (fits) {
+			++num_solutions;
+			for (std::size_t i = 0; i < frontier.size(); ++i) {
+				bomb_count[i] += (mask >> i) & 1;
+			}
+		}
+	}
+
+	solver::board_state_result result;
+	result.num_solutions = num_solutions;
+	if (frontier.empty()) {
+		return result;
+	}
+	auto const [min, max] = std::minmax_element(bomb_count.begin(), bomb_count.end());
+	for (std::size_t i = 0; i < frontier.size(); ++i) {
+		if (bomb_count[i] == *min) {
+			result.safest_positions.push_back(frontier[i]);
+		}
+		if (bomb_count[i] == *max) {
+			result.unsafest_positions.push_back(frontier[i]);
+		}
+	}
+	result.safe_certainty = 1 - *min / num_solutions;
+	result.unsafe_certainty = *max / num_solutions;
+	return result;
+}
+
+// Returns false if the position was too big to check
+bool test_against_brute_force(Minefield const& minefield) {
+	std::optional<solver::board_state_result> const oracle = brute_force_solve(minefield);
+	if (!oracle) {
+		return false;
+	}
+	solver::board_state_result const& expected = *oracle;
+	solver::board_state_result const actual = solver::explore_possible_minefield_states(minefield);
+
+	REQUIRE(actual.num_solutions == expected.num_solutions);
+	REQUIRE(to_set(actual.safest_positions) == to_set(expected.safest_positions));
+	REQUIRE(to_set(actual.unsafest_positions) == to_set(expected.unsafest_positions));
+	REQUIRE(actual.safe_certainty == Approx(expected.safe_certainty));
+	REQUIRE(actual.unsafe_certainty == Approx(expected.unsafe_certainty));
+	return true;
+}
+
+TEST_CASE("Each bomb placement is counted once", "[Oracle]") {
+
+	SECTION("Two bombs around one number") {
+		std::unique_ptr<Controller> control = create_board(R"(
+b..
+.o.
+..b)");
+		// Any 2 of the 8 neighbours
+		REQUIRE(solver::explore_possible_minefield_states(*control->snapshot()).num_solutions == 28);
+		REQUIRE(test_against_brute_force(*control->snapshot()));
+	}
+
+	SECTION("Overlapping numbers that need several bombs") {
+		std::unique_ptr<Controller> control = create_board(R"(
+bb.b
+.oo.
+b.bb
+....)");
+		REQUIRE(test_against_brute_force(*control->snapshot()));
+	}
+
+	SECTION("Random positions") {
+		std::mt19937 rng{ 1234 };
+		int num_checked = 0;
+		for (int round = 0; round < 200; ++round) {
+			int const width = 4 + rng() % 4;
+			int const height = 4 + rng() % 3;
+			int const num_mines = 2 + rng() % (width * height / 3);
+
+			Minefield minefield = random_position(rng, width, height, num_mines, 1 + rng() % 4);
+
+			CAPTURE(round);
+			num_checked += test_against_brute_force(minefield);
+		}
+		REQUIRE(num_checked > 150);
+	}
+}
+
+/*
+* Reference endgame solver: try every placement of exactly the number of mines on all covered cells, and keep
+* those that fit all the numbers. Gives up when there are too many covered cells to enumerate.
+*/
+std::optional<solver::board_state_result> brute_force_endgame(Minefield const& minefield) {
+	int const width = minefield.get_width();
+	int const height = minefield.get_height();
+
+	std::vector<Pos> covered;
+	std::vector<Pos> numbers;
+	for (auto const& [pos, cell] : minefield) {
+		if (cell.is_covered()) {
+			covered.push_back(pos);
+		}
+		else if (cell.get_num_adjacent_bombs() > 0) {
+			numbers.push_back(pos);
+		}
+	}
+	if (covered.size() > 18 || covered.empty()) {
+		return {};
+	}
+
+	double num_solutions = 0;
+	std::vector<double> bomb_count(covered.size(), 0.);
+	for (unsigned mask = 0; mask < (1u << covered.size()); ++mask) {
+		auto is_bomb = [&](Pos p) {
+			auto it = std::find(covered.begin(), covered.end(), p);
+			return it != covered.end() && (mask >> (it - covered.begin())) & 1;
+		};
+
+		int num_bombs = 0;
+		for (unsigned m = mask; m != 0; m >>= 1) {
+			num_bombs += m & 1;
+		}
+		bool fits = num_bombs == minefield.get_num_mines();
+		for (Pos number : numbers) {
+			std::vector<Pos> const adjacent = util::get_adjacent_positions(number, width, height);
+			fits = fits && std::count_if(adjacent.begin(), adjacent.end(), is_bomb)
+				== minefield.get_cell(number).get_num_adjacent_bombs();
+		}
+		if (fits) {
+			++num_solutions;
+			for (std::size_t i = 0; i < covered.size(); ++i) {
+				bomb_count[i] += (mask >> i) & 1;
+			}
+		}
+	}
+
+	solver::board_state_result result;
+	result.num_solutions = num_solutions;
+	auto const [min, max] = std::minmax_element(bomb_count.begin(), bomb_count.end());
+	for (std::size_t i = 0; i < covered.size(); ++i) {
+		if (bomb_count[i] == *min) {
+			result.safest_positions.push_back(covered[i]);
+		}
+		if (bomb_count[i] == *max) {
+			result.unsafest_positions.push_back(covered[i]);
+		}
+	}
+	result.safe_certainty = 1 - *min / num_solutions;
+	result.unsafe_certainty = *max / num_solutions;
+	return result;
+}
+
+TEST_CASE("Contradictions are cut off early", "[Order]") {
+	// A wide frontier: rows of covered cells with a 1 on every other cell between them, which takes the full search
+	// over half a million nodes. The number at the far end is then made impossible to satisfy next to its neighbour.
+	int const width = 21;
+	int const height = 3;
+	std::vector<std::uint8_t> cells(width * height, WINMINE_CELL_COVERED);
+	for (int x = 1; x < width; x += 2) {
+		cells[width + x] = 1;
+	}
+	auto const search = [&](std::uint8_t last_number, solver::SearchControl& control) {
+		cells[width + width - 2] = last_number;
+		util::Arena arena;
+		solver::ConstraintGraph graph{ &arena };
+		solver::compile_constraint_graph(solver::BoardView{ cells.data(), width, height, width, 30 }, graph);
+		solver::board_state_result result;
+		solver::solve_constraint_graph(graph, 30, arena, result, &control);
+		return result;
+	};
+
+	solver::SearchControl full;
+	solver::board_state_result const satisfiable = search(1, full);
+	REQUIRE(satisfiable.complete);
+	REQUIRE(satisfiable.num_solutions > 0);
+
+	// The 8 is forced, so it goes first and the 1 next to it fails the forward check right away
+	solver::SearchControl pruned;
+	solver::board_state_result const contradiction = search(8, pruned);
+	REQUIRE(contradiction.complete);
+	REQUIRE(contradiction.num_solutions == 0);
+	CAPTURE(full.get_num_nodes(), pruned.get_num_nodes());
+	REQUIRE(pruned.get_num_nodes() < 10);
+	REQUIRE(pruned.get_num_nodes() * 1000 < full.get_num_nodes());
+}
+
+TEST_CASE("Endgame counts full bomb placements", "[Endgame]") {
+
+	SECTION("Interior cells take part") {
+		// The 1 has its bomb on one of two cells, the other two mines are on the four cells on the right
+		std::unique_ptr<Controller> control = create_board(R"(
+ob.b.
+oo...
+oo.b.)");
+		solver::board_state_result const result = solver::explore_endgame_states(*control->snapshot(), false);
+		std::optional<solver::board_state_result> const expected = brute_force_endgame(*control->snapshot());
+		REQUIRE(expected);
+		REQUIRE(result.num_solutions == expected->num_solutions);
+		REQUIRE(to_set(result.safest_positions) == to_set(expected->safest_positions));
+		REQUIRE(result.safe_certainty == Approx(expected->safe_certainty));
+	}
+
+	SECTION("Random positions") {
+		std::mt19937 rng{ 4321 };
+		int num_checked = 0;
+		for (int round = 0; round < 200; ++round) {
+			int const width = 3 + rng() % 3;
+			int const height = 3 + rng() % 3;
+			int const num_mines = 1 + rng() % (width * height / 3);
+
+			Minefield minefield = random_position(rng, width, height, num_mines, 1 + rng() % 3);
+
+			std::optional<solver::board_state_result> const expected = brute_force_endgame(minefield);
+			if (!expected || minefield.is_game_won()) {
+				continue;
+			}
+			CAPTURE(round);
+			solver::board_state_result const actual = solver::explore_endgame_states(minefield, false);
+			REQUIRE(actual.num_solutions == expected->num_solutions);
+			REQUIRE(to_set(actual.safest_positions) == to_set(expected->safest_positions));
+			REQUIRE(to_set(actual.unsafest_positions) == to_set(expected->unsafest_positions));
+			REQUIRE(actual.safe_certainty == Approx(expected->safe_certainty));
+			REQUIRE(actual.unsafe_certainty == Approx(expected->unsafe_certainty));
+
+			// The tree search can only pick a move that wins at most as often as it survives
+			solver::board_state_result const searched = solver::explore_endgame_states(minefield);
+			if (searched.win_probability) {
+				REQUIRE(*searched.win_probability <= searched.safe_certainty + 1e-9);
+				REQUIRE(*searched.win_probability > 0);
+			}
+			++num_checked;
+		}
+		REQUIRE(num_checked > 150);
+	}
+
+	SECTION("A true fifty fifty") {
+		// Two covered cells, one mine, and both 1s see both of them
+		std::unique_ptr<Controller> control = create_board(R"(
+.b
+oo
+oo)");
+		solver::board_state_result const result = solver::explore_endgame_states(*control->snapshot());
+		REQUIRE(result.win_probability);
+		REQUIRE(*result.win_probability == Approx(.5));
+		REQUIRE(result.safest_positions.size() == 1);
+	}
+}
+
+TEST_CASE("Board analysis", "[Analysis]") {
+
+	SECTION("Matches every bomb placement") {
+		std::mt19937 rng{ 8765 };
+		int num_checked = 0;
+		for (int round = 0; round < 200; ++round) {
+			int const width = 3 + rng() % 3;
+			int const height = 3 + rng() % 3;
+			int const num_mines = 1 + rng() % (width * height / 3);
+
+			Minefield minefield = random_position(rng, width, height, num_mines, 1 + rng() % 3);
+
+			std::optional<solver::board_state_result> const expected = brute_force_endgame(minefield);
+			if (!expected || minefield.is_game_won()) {
+				continue;
+			}
+			CAPTURE(round);
+			std::shared_ptr<solver::BoardAnalysis const> const analysis = solver::analyze(minefield);
+			REQUIRE(analysis->num_solutions == Approx(expected->num_solutions));
+
+			// The safest covered cells are the ones with the lowest probability
+			std::vector<Pos> covered;
+			for (auto const& [pos, cell] : minefield) {
+				if (cell.is_covered()) {
+					covered.push_back(pos);
+				}
+				else {
+					REQUIRE(analysis->probability_at(pos) == 0);
+				}
+			}
+			double const min_probability = analysis->probability_at(*std::min_element(covered.begin(), covered.end(),
+				[&](Pos const& lhs, Pos const& rhs) { return analysis->probability_at(lhs) < analysis->probability_at(rhs); }));
+			REQUIRE(1 - min_probability == Approx(expected->safe_certainty));
+			if (expected->safe_certainty == 1) {
+				REQUIRE(to_set(analysis->forced_safe) == to_set(expected->safest_positions));
+			}
+			else {
+				REQUIRE(analysis->forced_safe.empty());
+			}
+			if (expected->unsafe_certainty == 1) {
+				REQUIRE(to_set(analysis->forced_mines) == to_set(expected->unsafest_positions));
+			}
+			++num_checked;
+		}
+		REQUIRE(num_checked > 150);
+	}
+
+	SECTION("Big boards don't overflow") {
+		Minefield minefield{ util::GameSettings{ 100, 100, 2000 }, 1234 };
+		minefield.expose({ 50, 50 });
+		std::shared_ptr<solver::BoardAnalysis const> const analysis = solver::analyze(minefield);
+		for (double probability : analysis->mine_probability) {
+			REQUIRE(probability >= 0);
+			REQUIRE(probability <= 1);
+		}
+		REQUIRE(analysis->forced_safe.size() < 100 * 100);
+	}
+
+	SECTION("Follows the board") {
+		// The 1 has its mine on its right, the other one is on either of the last two cells
+		Minefield minefield{ 4, 1, { Pos{ 1, 0 }, Pos{ 3, 0 } } };
+		minefield.expose({ 0, 0 });
+		std::shared_ptr<solver::BoardAnalysis const> const first = solver::analyze(minefield);
+		REQUIRE(first->forced_mines == std::vector<Pos>{ Pos{ 1, 0 } });
+		REQUIRE(first->probability_at({ 2, 0 }) == Approx(.5));
+		REQUIRE(first->num_solutions == Approx(2));
+
+		// Flags don't matter to the solver
+		minefield.toggle_flagged({ 1, 0 });
+		REQUIRE(solver::analyze(minefield)->forced_mines == first->forced_mines);
+
+		Minefield copy = minefield;
+		copy.expose({ 2, 0 });
+		std::shared_ptr<solver::BoardAnalysis const> const second = solver::analyze(copy);
+		REQUIRE(to_set(second->forced_mines) == to_set(std::vector<Pos>{ Pos{ 1, 0 }, Pos{ 3, 0 } }));
+		REQUIRE(solver::analyze(minefield)->probability_at({ 2, 0 }) == Approx(.5));
+	}
+}
+
+// Independent 1s with eight covered cells each, 8^n solutions, far too many to count in a test
+std::unique_ptr<Controller> create_slow_board(int num_ones) {
+	std::string rows[3];
+	for (int i = 0; i < num_ones; ++i) {
+		rows[0] += "b..";
+		rows[1] += ".o.";
+		rows[2] += "...";
+	}
+	return create_board("\n" + rows[0] + "\n" + rows[1] + "\n" + rows[2]);
+}
+
+TEST_CASE("Cancelling a search", "[Cancel]") {
+
+	SECTION("Cancelled before it starts") {
+		std::unique_ptr<Controller> control = create_slow_board(20);
+		std::shared_ptr<Minefield const> const board = control->snapshot();
+
+		util::Arena arena;
+		solver::ConstraintGraph graph{ &arena };
+		solver::compile_constraint_graph(*board, graph);
+		solver::SearchControl search_control;
+		search_control.cancel();
+		solver::board_state_result result;
+		solver::solve_constraint_graph(graph, board->get_num_mines(), arena, result, &search_control);
+		REQUIRE(!result.complete);
+	}
+
+	SECTION("Stopped at a node limit") {
+		std::unique_ptr<Controller> control = create_slow_board(20);
+		util::Arena arena;
+		solver::SearchControl search_control;
+		search_control.set_node_limit(10000);
+		solver::board_state_result result;
+		solver::find_next_moves(*control->snapshot(), arena, result, &search_control);
+		REQUIRE(!result.complete);
+		REQUIRE(search_control.is_cancelled());
+		REQUIRE(search_control.get_num_nodes() >= 10000);
+		REQUIRE(search_control.get_num_nodes() < 10000 + solver::SearchControl::check_interval);
+	}
+
+	SECTION("Cancelled while it runs, with progress") {
+		std::unique_ptr<Controller> control = create_slow_board(20);
+		solver::AsyncSearch search = solver::find_next_moves_async(control->snapshot());
+		for (int i = 0; i < 2000 && search.get_progress() == 0; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+		double const progress = search.get_progress();
+		REQUIRE(progress > 0);
+		REQUIRE(progress < 1);
+		REQUIRE(!search.is_ready());
+
+		search.cancel();
+		solver::board_state_result const result = search.get();
+		REQUIRE(!result.complete);
+		REQUIRE(search.get_progress() >= progress);
+	}
+
+	SECTION("Finishes like the blocking search") {
+		std::unique_ptr<Controller> control = create_board(R"(
+.....
+.ob..
+..o..
+..bo.
+.....)");
+		std::shared_ptr<Minefield const> const board = control->snapshot();
+		bool called = false;
+		solver::AsyncSearch search = solver::find_next_moves_async(board, [&called]() { called = true; });
+		solver::board_state_result const result = search.get();
+		solver::board_state_result const expected = solver::find_next_moves(*board);
+		REQUIRE(called);
+		REQUIRE(result.complete);
+		REQUIRE(search.get_progress() == 1);
+		REQUIRE(result.safest_positions == expected.safest_positions);
+		REQUIRE(result.num_solutions == expected.num_solutions);
+	}
+}
+
+TEST_CASE("Pattern table deductions", "[Patterns]") {
+	static solver::PatternTable const table = solver::PatternTable::generate();
+	REQUIRE(table.size() > 0);
+
+	SECTION("Saved tables load back the same") {
+		std::string const path = "test_patterns.bin";
+		REQUIRE(table.save(path));
+		std::optional<solver::PatternTable> const loaded = solver::PatternTable::load(path);
+		std::remove(path.c_str());
+		REQUIRE(loaded);
+		REQUIRE(loaded->size() == table.size());
+
+		REQUIRE(!solver::PatternTable::load("no_such_file.bin"));
+	}
+
+	SECTION("Broken tables don't load") {
+		std::string const path = "test_patterns.bin";
+		// A header then slots of { pattern, safe | bombs << 16 }, an unused pattern is all ones
+		auto const load_words = [&](std::vector<std::uint32_t> const& words) {
+			{
+				std::ofstream file{ path, std::ios::binary };
+				file.write(reinterpret_cast<char const*>(words.data()), words.size() * sizeof(std::uint32_t));
+			}
+			std::optional<solver::PatternTable> const loaded = solver::PatternTable::load(path);
+			std::remove(path.c_str());
+			return loaded.has_value();
+		};
+		std::uint32_t const magic = 0x54504D57;
+		std::uint32_t const unused = 0xFFFFFFFF;
+
+		REQUIRE(load_words({ magic, 1, 2, 1, 7, 1, unused, 0 }));
+		REQUIRE(!load_words({ magic, 1, 0x80000000u, 1 }));           // far too big to allocate
+		REQUIRE(!load_words({ magic, 1, 2, 1, 7, 1 }));                // cut short
+		REQUIRE(!load_words({ magic, 1, 2, 1, 7, 1, unused, 0, 0 }));  // trailing bytes
+		REQUIRE(!load_words({ magic, 1, 2, 2, 7, 1, 8, 1 }));          // full, lookups would never end
+		REQUIRE(!load_words({ magic, 1, 2, 1, 7, 1, 8, 1 }));          // full, but says it isn't
+	}
+
+	SECTION("Everything the table proves, the search proves too") {
+		std::mt19937 rng{ 555 };
+		util::Arena arena;
+		int num_found = 0;
+		for (int round = 0; round < 300; ++round) {
+			int const width = 5 + rng() % 6;
+			int const height = 5 + rng() % 6;
+			int const num_mines = 3 + rng() % (width * height / 5);
+
+			Minefield minefield = random_position(rng, width, height, num_mines, 1 + rng() % 4);
+
+			CAPTURE(round);
+			solver::ConstraintGraph graph{ &arena };
+			solver::compile_constraint_graph(minefield, graph);
+			solver::board_state_result patterns;
+			if (!solver::find_pattern_moves(graph, table, patterns)) {
+				continue;
+			}
+			++num_found;
+
+			solver::board_state_result const searched = solver::explore_possible_minefield_states(minefield);
+			REQUIRE(searched.safe_certainty == 1);
+			std::unordered_set<Pos> const safe = to_set(searched.safest_positions);
+			for (Pos const& pos : patterns.safest_positions) {
+				REQUIRE(safe.count(pos) == 1);
+			}
+			if (!patterns.unsafest_positions.empty()) {
+				REQUIRE(searched.unsafe_certainty == 1);
+				std::unordered_set<Pos> const bombs = to_set(searched.unsafest_positions);
+				for (Pos const& pos : patterns.unsafest_positions) {
+					REQUIRE(bombs.count(pos) == 1);
+				}
+			}
+		}
+		REQUIRE(num_found > 50);
+	}
+
+	SECTION("An empty table knows nothing") {
+		std::unique_ptr<Controller> control = create_board(R"(
+b..
+.o.
+..b)");
+		util::Arena arena;
+		solver::ConstraintGraph graph{ &arena };
+		solver::compile_constraint_graph(*control->snapshot(), graph);
+		solver::board_state_result result;
+		REQUIRE(!solver::find_pattern_moves(graph, solver::PatternTable{}, result));
+	}
+}
+
+namespace {
+
+// The visible board as the C interface takes it, with stride - width bytes of padding that is no cell after every row
+std::vector<std::uint8_t> to_bytes(Minefield const& minefield, int stride) {
+	std::vector<std::uint8_t> bytes(stride * minefield.get_height(), 0xff);
+	for (auto const& [pos, cell] : minefield) {
+		std::uint8_t& byte = bytes[pos.y * stride + pos.x];
+		if (cell.is_exposed()) {
+			byte = static_cast<std::uint8_t>(cell.get_num_adjacent_bombs());
+		}
+		else {
+			byte = cell.is_flagged() ? WINMINE_CELL_FLAGGED : WINMINE_CELL_COVERED;
+		}
+	}
+	return bytes;
+}
+
+winmine_board to_board(Minefield const& minefield, std::vector<std::uint8_t> const& bytes, int stride) {
+	return { bytes.data(), minefield.get_width(), minefield.get_height(), stride, minefield.get_num_mines() };
+}
+
+} // end anonymous namespace
+
+TEST_CASE("C interface", "[CInterface]") {
+
+	SECTION("Same odds as analyze") {
+		std::mt19937 rng{ 4321 };
+		for (int round = 0; round < 100; ++round) {
+			int const width = 3 + rng() % 4;
+			int const height = 3 + rng() % 4;
+			Minefield minefield{ util::GameSettings{ width, height, 1 + static_cast<int>(rng() % (width * height / 3)) }, static_cast<unsigned>(rng()) };
+			minefield.expose({ static_cast<int>(rng() % width), static_cast<int>(rng() % height) });
+			if (minefield.is_game_lost() || minefield.is_game_won()) {
+				continue;
+			}
+			minefield.toggle_flagged({ 0, 0 }); // flags are covered cells to the solver
+
+			int const stride = width + 3;
+			std::vector<std::uint8_t> const bytes = to_bytes(minefield, stride);
+			winmine_board const board = to_board(minefield, bytes, stride);
+			std::vector<double> probabilities(width * height, -1.);
+			REQUIRE(winmine_mine_probabilities(&board, probabilities.data()) == WINMINE_OK);
+
+			CAPTURE(round);
+			std::shared_ptr<solver::BoardAnalysis const> const analysis = solver::analyze(minefield);
+			for (int i = 0; i < width * height; ++i) {
+				REQUIRE(probabilities[i] == Approx(analysis->mine_probability[i]));
+			}
+		}
+	}
+
+	SECTION("Next move") {
+		std::unique_ptr<Controller> control = create_board(R"(
+ooo
+.b.
+...)");
+		std::shared_ptr<Minefield const> const minefield = control->snapshot();
+		std::vector<std::uint8_t> const bytes = to_bytes(*minefield, 3);
+		winmine_board const board = to_board(*minefield, bytes, 3);
+		winmine_move move;
+		REQUIRE(winmine_next_move(&board, &move) == WINMINE_OK);
+		REQUIRE(move.safe_probability == 1);
+		REQUIRE(minefield->get_cell({ move.x, move.y }).is_covered());
+		REQUIRE(!(move.x == 1 && move.y == 1)); // the one mine has to touch all three numbers
+
+		// Nothing exposed, every cell is as risky as the next
+		std::vector<std::uint8_t> const untouched(81, WINMINE_CELL_COVERED);
+		winmine_board const fresh{ untouched.data(), 9, 9, 9, 10 };
+		REQUIRE(winmine_next_move(&fresh, &move) == WINMINE_OK);
+		REQUIRE(move.safe_probability == Approx(1 - 10. / 81));
+	}
+
+	SECTION("Bad boards") {
+		std::vector<std::uint8_t> bytes{ 1, WINMINE_CELL_COVERED, WINMINE_CELL_COVERED, WINMINE_CELL_COVERED };
+		double probabilities[4];
+		winmine_move move;
+
+		winmine_board board{ bytes.data(), 2, 2, 2, 1 };
+		REQUIRE(winmine_mine_probabilities(&board, probabilities) == WINMINE_OK);
+		REQUIRE(winmine_mine_probabilities(nullptr, probabilities) == WINMINE_INVALID_ARGUMENT);
+		REQUIRE(winmine_mine_probabilities(&board, nullptr) == WINMINE_INVALID_ARGUMENT);
+
+		board.stride = 1;
+		REQUIRE(winmine_mine_probabilities(&board, probabilities) == WINMINE_INVALID_ARGUMENT);
+		board.stride = 2;
+		board.num_mines = 5;
+		REQUIRE(winmine_mine_probabilities(&board, probabilities) == WINMINE_INVALID_ARGUMENT);
+		board.num_mines = 4; // only three cells are covered
+		REQUIRE(winmine_mine_probabilities(&board, probabilities) == WINMINE_INVALID_ARGUMENT);
+		REQUIRE(winmine_next_move(&board, &move) == WINMINE_INVALID_ARGUMENT);
+		board.num_mines = 3; // fits the board, just not the 1
+		REQUIRE(winmine_next_move(&board, &move) == WINMINE_NO_SOLUTION);
+
+		// The 1 needs a mine next to it
+		board.num_mines = 0;
+		REQUIRE(winmine_mine_probabilities(&board, probabilities) == WINMINE_NO_SOLUTION);
+		REQUIRE(winmine_next_move(&board, &move) == WINMINE_NO_SOLUTION);
+
+		board.num_mines = 1;
+		bytes[3] = WINMINE_CELL_FLAGGED + 1;
+		REQUIRE(winmine_next_move(&board, &move) == WINMINE_INVALID_ARGUMENT);
+		std::fill(bytes.begin(), bytes.end(), 0);
+		REQUIRE(winmine_next_move(&board, &move) == WINMINE_INVALID_ARGUMENT); // nothing left to expose
+	}
+}
@@ -0,0 +1,117 @@
+#include "winmine_solver.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "board_view.h"
+#include "constraint_graph.h"
+#include "opening_book.h"
+#include "solver.h"
+
+#include "../lib/arena.h"
+#include "../lib/util.h"
+
+namespace {
+
+// Biggest side the solver takes, so every cell index fits an int
+constexpr std::int32_t max_side = 1 << 15;
+
+bool is_valid(winmine_board const* board) {
+    if (board == nullptr || board->cells == nullptr) {
+        return false;
+    }
+    if (board->width <= 0 || board->height <= 0 || board->width > max_side || board->height > max_side) {
+        return false;
+    }
+    if (board->stride < board->width || board->num_mines < 0) {
+        return false;
+    }
+    std::int32_t num_covered = 0;
+    for (std::int32_t y = 0; y < board->height; ++y) {
+        std::uint8_t const* row = board->cells + static_cast<std::ptrdiff_t>(y) * board->stride;
+        if (std::any_of(row, row + board->width, [](std::uint8_t cell) { return cell > WINMINE_CELL_FLAGGED; })) {
+            return false;
+        }
+        num_covered += static_cast<std::int32_t>(
+            std::count_if(row, row + board->width, [](std::uint8_t cell) { return cell >= WINMINE_CELL_COVERED; }));
+    }
+    // The mines all hide under covered cells, more of them than that would make odds above 1
+    return board->num_mines <= num_covered;
+}
+
+solver::BoardView view_of(winmine_board const& board) {
+    return { board.cells, board.width, board.height, board.stride, board.num_mines };
+}
+
+// Run f, turning whatever it throws into a status, as nothing may get out through the C interface
+template<typename F>
+winmine_status guarded(F f) {
+    try {
+        return f();
+    }
+    catch (std::bad_alloc const&) {
+        return WINMINE_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return WINMINE_INTERNAL_ERROR;
+    }
+}
+
+} // end anonymous namespace
+
+std::int32_t winmine_solver_api_version(void) {
+    return WINMINE_SOLVER_API_VERSION;
+}
+
+winmine_status winmine_mine_probabilities(winmine_board const* board, double* probabilities) {
+    if (!is_valid(board) || probabilities == nullptr) {
+        return WINMINE_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        solver::BoardView const view = view_of(*board);
+        thread_local util::Arena arena;
+        arena.reset();
+
+        solver::ConstraintGraph graph{ &arena };
+        solver::compile_constraint_graph(view, graph);
+        std::fill(probabilities, probabilities + board->width * board->height, 0.);
+        double const num_solutions = solver::solve_mine_probabilities(graph, view.get_num_mines(), view.get_width(), arena, probabilities);
+        return num_solutions > 0 ? WINMINE_OK : WINMINE_NO_SOLUTION;
+        });
+}
+
+winmine_status winmine_next_move(winmine_board const* board, winmine_move* move) {
+    if (!is_valid(board) || move == nullptr) {
+        return WINMINE_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        solver::BoardView const view = view_of(*board);
+        int const num_covered = view.get_width() * view.get_height() - view.count_exposed_cells();
+        if (num_covered == 0) {
+            return WINMINE_INVALID_ARGUMENT;
+        }
+
+        thread_local util::Arena arena;
+        thread_local solver::board_state_result result;
+        solver::find_next_moves(view, arena, result);
+
+        if (!result.safest_positions.empty()) {
+            // A proof from the pattern table counts no solutions, but is certain
+            if (result.num_solutions == 0 && result.safe_certainty != 1) {
+                return WINMINE_NO_SOLUTION;
+            }
+            move->x = result.safest_positions.back().x;
+            move->y = result.safest_positions.back().y;
+            move->safe_probability = result.safe_certainty;
+            return WINMINE_OK;
+        }
+
+        // Nothing next to a number is covered, so every covered cell is as likely as the next to be a mine
+        util::Pos const pos = solver::best_blind_click(view);
+        move->x = pos.x;
+        move->y = pos.y;
+        move->safe_probability = 1 - static_cast<double>(view.get_num_mines()) / num_covered;
+        return WINMINE_OK;
+        });
+}
@@ -0,0 +1,77 @@
+/*
+* C interface to the solver, for programs that keep their own boards. Nothing here is C++, and the layout of
+* the structs only ever grows at the end, with WINMINE_SOLVER_API_VERSION going up.
+*
+* A board is read where it lies, one byte per cell: 0 to 8 for an exposed cell showing that number, or one of
+* WINMINE_CELL_COVERED and WINMINE_CELL_FLAGGED. Flags are treated as covered cells, the solver makes up its own
+* mind about them. All functions can be called from any number of threads at once.
+*/
+#ifndef WINMINE_SOLVER_H
+#define WINMINE_SOLVER_H
+
+#include <stdint.h>
+
+#if defined(WINMINE_SOLVER_SHARED) && defined(_WIN32)
+#ifdef WINMINE_SOLVER_BUILD
+#define WINMINE_SOLVER_API __declspec(dllexport)
+#else
+#define WINMINE_SOLVER_API __declspec(dllimport)
+#endif
+#elif defined(WINMINE_SOLVER_SHARED)
+#define WINMINE_SOLVER_API __attribute__((visibility("default")))
+#else
+#define WINMINE_SOLVER_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WINMINE_SOLVER_API_VERSION 1
+
+#define WINMINE_CELL_COVERED 9
+#define WINMINE_CELL_FLAGGED 10
+
+typedef enum winmine_status {
+    WINMINE_OK = 0,
+    WINMINE_INVALID_ARGUMENT = 1, /* a null pointer, a bad size, a byte that is no cell, or more mines than covered cells */
+    WINMINE_NO_SOLUTION = 2,      /* no placement of the mines fits the numbers shown */
+    WINMINE_OUT_OF_MEMORY = 3,
+    WINMINE_INTERNAL_ERROR = 4
+} winmine_status;
+
+/* A board owned by the caller. Cell (x, y) is cells[y * stride + x], stride is at least width. */
+typedef struct winmine_board {
+    const uint8_t* cells;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    int32_t num_mines; /* on the whole board, flagged or not */
+} winmine_board;
+
+typedef struct winmine_move {
+    int32_t x;
+    int32_t y;
+    double safe_probability; /* 1 when the cell is certain to be safe */
+} winmine_move;
+
+/* WINMINE_SOLVER_API_VERSION of the library, which may be newer than the header the caller was built with */
+WINMINE_SOLVER_API int32_t winmine_solver_api_version(void);
+
+/*
+* Write the chance of every cell to be a mine to probabilities[y * width + x], which has room for
+* width * height doubles. Exposed cells get 0. On WINMINE_NO_SOLUTION all chances are 0.
+*/
+WINMINE_SOLVER_API winmine_status winmine_mine_probabilities(const winmine_board* board, double* probabilities);
+
+/*
+* The cell the solver would expose next: a safe one when there is one, the one most likely to be safe otherwise,
+* and the opening book's pick on an untouched board. WINMINE_INVALID_ARGUMENT when no cell is covered.
+*/
+WINMINE_SOLVER_API winmine_status winmine_next_move(const winmine_board* board, winmine_move* move);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WINMINE_SOLVER_H */
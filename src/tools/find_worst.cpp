@@ -0,0 +1,308 @@
+// find_worst.cpp : Searches for the positions the solver is slowest on, and writes them to the benchmark corpus.
+//
+// Usage: winmine_find_worst <width> <height> <mines> <corpus file> [nodes|time] [restarts] [steps per restart]
+//
+// A position is a mine layout plus the cells clicked on it. Each restart starts from random ones, and climbs
+// from there one change at a time: a mine moved, a click added or a click taken back. A change is kept when the
+// solver needs at least as many search nodes, or as much time, as before. A search that doesn't finish within
+// 100 ms is stopped, and is worse than any that finished, those are compared by the nodes they got through.
+// Where each climb ended up goes into the corpus, the worst of them are written as text boards, which
+// winmine_bench plays with a node limit.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/minefield.h"
+#include "../solver/solver.h"
+
+using util::Pos;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Worst positions kept in the corpus
+constexpr std::size_t corpus_size = 10;
+// A search that runs longer than this is cancelled, its position counts as worse than any that finished
+constexpr std::chrono::milliseconds search_timeout{ 100 };
+
+struct Position {
+    std::vector<bool> mines; // per cell, row by row
+    std::vector<Pos> clicks;
+};
+
+struct Measurement {
+    std::uint64_t num_nodes = 0; // up to where it was cancelled, when it timed out
+    double milliseconds = 0;
+    bool timed_out = false;
+};
+
+struct Found {
+    std::uint64_t hash;
+    Measurement measurement;
+    std::shared_ptr<Minefield const> board;
+};
+
+class Finder {
+    util::GameSettings const settings;
+    bool const by_time;
+    std::mt19937 random;
+    std::vector<Found> worst; // worst first, at most corpus_size
+    int num_timed_out = 0;
+
+    int num_cells() const { return settings.width * settings.height; }
+    Pos pos_of(int index) const { return { index % settings.width, index / settings.width }; }
+
+    int random_cell() {
+        return std::uniform_int_distribution<int>{ 0, num_cells() - 1 }(random);
+    }
+
+    // The board after the clicks, or nothing when they won the game
+    std::shared_ptr<Minefield const> build(Position const& position) const {
+        std::vector<Pos> mine_positions;
+        for (int i = 0; i < num_cells(); ++i) {
+            if (position.mines[i]) {
+                mine_positions.push_back(pos_of(i));
+            }
+        }
+        auto board = std::make_shared<Minefield>(settings.width, settings.height, mine_positions);
+        for (Pos const& click : position.clicks) {
+            board->expose(click);
+        }
+        if (board->is_game_won() || board->count_exposed_cells() == 0) {
+            return nullptr;
+        }
+        return board;
+    }
+
+    Position random_position() {
+        Position position;
+        position.mines.assign(num_cells(), false);
+        for (int placed = 0; placed < settings.num_bombs;) {
+            int const cell = random_cell();
+            placed += !position.mines[cell];
+            position.mines[cell] = true;
+        }
+
+        // Click safe cells until a random share of them is open
+        int const num_safe = num_cells() - settings.num_bombs;
+        int const target = static_cast<int>(num_safe * std::uniform_real_distribution<double>{ .05, .6 }(random));
+        std::shared_ptr<Minefield const> built;
+        for (int tries = 0; tries < 10 * num_cells(); ++tries) {
+            int const cell = random_cell();
+            if (position.mines[cell]) {
+                continue;
+            }
+            position.clicks.push_back(pos_of(cell));
+            built = build(position);
+            if (!built) {
+                position.clicks.pop_back();
+                break;
+            }
+            if (built->count_exposed_cells() >= target) {
+                break;
+            }
+        }
+        return position;
+    }
+
+    // Move a mine, click one more safe cell, or take a click back
+    Position mutate(Position position) {
+        int const kind = std::uniform_int_distribution<int>{ 0, 2 }(random);
+        if (kind == 0 || position.clicks.empty()) {
+            int from = random_cell();
+            int to = random_cell();
+            while (!position.mines[from]) {
+                from = random_cell();
+            }
+            while (position.mines[to]) {
+                to = random_cell();
+            }
+            position.mines[from] = false;
+            position.mines[to] = true;
+            // A click on the new mine would lose the game
+            Pos const mine = pos_of(to);
+            position.clicks.erase(std::remove(position.clicks.begin(), position.clicks.end(), mine), position.clicks.end());
+        }
+        else if (kind == 1) {
+            int cell = random_cell();
+            while (position.mines[cell]) {
+                cell = random_cell();
+            }
+            position.clicks.push_back(pos_of(cell));
+        }
+        else {
+            std::size_t const index = std::uniform_int_distribution<std::size_t>{ 0, position.clicks.size() - 1 }(random);
+            position.clicks.erase(position.clicks.begin() + index);
+        }
+        return position;
+    }
+
+    // Time the solver on board, giving up after search_timeout
+    Measurement measure(std::shared_ptr<Minefield const> const& board) const {
+        auto const finished = std::make_shared<Clock::time_point>();
+        auto const start = Clock::now();
+        solver::AsyncSearch search = solver::find_next_moves_async(board, [finished]() { *finished = Clock::now(); });
+        while (!search.is_ready() && Clock::now() - start < search_timeout) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+        }
+        search.cancel();
+        Measurement measurement;
+        measurement.timed_out = !search.get().complete;
+        measurement.num_nodes = search.get_control()->get_num_nodes();
+        measurement.milliseconds = std::chrono::duration<double, std::milli>(*finished - start).count();
+        return measurement;
+    }
+
+    // Whether the solver did worse on lhs than on rhs. Searches that timed out all took about as long, they are
+    // compared by how far they got.
+    bool is_worse(Measurement const& lhs, Measurement const& rhs) const {
+        if (lhs.timed_out != rhs.timed_out) {
+            return lhs.timed_out;
+        }
+        if (by_time && !lhs.timed_out) {
+            return lhs.milliseconds > rhs.milliseconds;
+        }
+        return lhs.num_nodes > rhs.num_nodes;
+    }
+
+    // Keep board if it is among the worst climbs, once per distinct board
+    void offer(std::shared_ptr<Minefield const> board, Measurement const& measurement) {
+        std::uint64_t const hash = board->get_hash();
+        auto const same = std::find_if(worst.begin(), worst.end(), [hash](Found const& found) { return found.hash == hash; });
+        if (same != worst.end() || (worst.size() == corpus_size && !is_worse(measurement, worst.back().measurement))) {
+            return;
+        }
+        worst.push_back({ hash, measurement, std::move(board) });
+        std::sort(worst.begin(), worst.end(), [this](Found const& lhs, Found const& rhs) {
+            return is_worse(lhs.measurement, rhs.measurement);
+            });
+        if (worst.size() > corpus_size) {
+            worst.pop_back();
+        }
+    }
+
+public:
+    Finder(util::GameSettings settings, bool by_time)
+        : settings{ settings }
+        , by_time{ by_time }
+    {}
+
+    // Climb from a random position, returns the worst measurement reached, if any position was playable
+    std::optional<Measurement> climb(unsigned seed, int steps) {
+        random.seed(seed);
+        Position position = random_position();
+        std::shared_ptr<Minefield const> board = build(position);
+        std::optional<Measurement> current;
+        if (board) {
+            current = measure(board);
+            num_timed_out += current->timed_out;
+        }
+
+        for (int step = 0; step < steps; ++step) {
+            Position candidate = mutate(position);
+            std::shared_ptr<Minefield const> const candidate_board = build(candidate);
+            if (!candidate_board) {
+                continue;
+            }
+            Measurement const candidate_measurement = measure(candidate_board);
+            num_timed_out += candidate_measurement.timed_out;
+            if (!current || !is_worse(*current, candidate_measurement)) {
+                current = candidate_measurement;
+                position = std::move(candidate);
+                board = candidate_board;
+            }
+        }
+
+        if (board) {
+            offer(board, *current);
+        }
+        return current;
+    }
+
+    /*
+    * One board per block: a comment line with what it cost when it was found, then a row of text per board row.
+    * 'b' is a mine, 'o' is exposed and '.' is covered. Blocks are separated by an empty line.
+    */
+    bool write(std::string const& path) const {
+        std::ofstream file{ path };
+        file << "# Worst positions for the solver, written by winmine_find_worst and played by winmine_bench\n\n";
+        for (Found const& found : worst) {
+            Minefield const& board = *found.board;
+            file << "# " << board.get_width() << "x" << board.get_height() << ", " << board.get_num_mines() << " mines: "
+                << found.measurement.num_nodes << " nodes, " << found.measurement.milliseconds << " ms"
+                << (found.measurement.timed_out ? ", stopped unfinished\n" : "\n");
+            for (int y = 0; y < board.get_height(); ++y) {
+                for (int x = 0; x < board.get_width(); ++x) {
+                    Cell const& cell = board.get_cell({ x, y });
+                    file << (cell.is_bomb() ? 'b' : cell.is_exposed() ? 'o' : '.');
+                }
+                file << '\n';
+            }
+            file << '\n';
+        }
+        return static_cast<bool>(file);
+    }
+
+    std::size_t size() const { return worst.size(); }
+    int get_num_timed_out() const { return num_timed_out; }
+};
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 5 || argc > 8) {
+        std::cout << "Usage: winmine_find_worst <width> <height> <mines> <corpus file> [nodes|time] [restarts] [steps per restart]\n";
+        return 1;
+    }
+    util::GameSettings const settings{ std::stoi(argv[1]), std::stoi(argv[2]), std::stoi(argv[3]) };
+    if (settings.num_bombs <= 0 || settings.num_bombs >= settings.width * settings.height) {
+        std::cout << "The board needs at least one mine and one safe cell\n";
+        return 1;
+    }
+    std::string const objective = argc >= 6 ? argv[5] : "nodes";
+    if (objective != "nodes" && objective != "time") {
+        std::cout << "Unknown objective " << objective << ", use nodes or time\n";
+        return 1;
+    }
+    int const num_restarts = argc >= 7 ? std::stoi(argv[6]) : 20;
+    int const steps = argc >= 8 ? std::stoi(argv[7]) : 200;
+
+    // Clicks that win a game print it
+    std::streambuf* const console = std::cout.rdbuf(nullptr);
+
+    Finder finder{ settings, objective == "time" };
+    for (int restart = 0; restart < num_restarts; ++restart) {
+        std::optional<Measurement> const reached = finder.climb(restart, steps);
+
+        std::cout.rdbuf(console);
+        std::cout << "Restart " << restart << ": ";
+        if (reached) {
+            std::cout << reached->num_nodes << " nodes, " << reached->milliseconds << " ms"
+                << (reached->timed_out ? ", stopped unfinished\n" : "\n");
+        }
+        else {
+            std::cout << "no playable position\n";
+        }
+        std::cout.rdbuf(nullptr);
+    }
+    std::cout.rdbuf(console);
+
+    if (!finder.write(argv[4])) {
+        std::cout << "Could not write " << argv[4] << '\n';
+        return 1;
+    }
+    std::cout << "Wrote " << finder.size() << " positions to " << argv[4] << ", "
+        << finder.get_num_timed_out() << " searches were stopped after " << search_timeout.count() << " ms\n";
+    return 0;
+}
@@ -0,0 +1,48 @@
+// gen_openings.cpp : Writes the opening book, where to click first on the classic board sizes.
+//
+// Usage: winmine_gen_openings <output file> [games per cell]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../control/simulation.h"
+#include "../solver/opening_book.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 3) {
+        std::cout << "Usage: winmine_gen_openings <output file> [games per cell]\n";
+        return 1;
+    }
+    int const games_per_cell = argc == 3 ? std::stoi(argv[2]) : 100;
+
+    util::GameSettings const configurations[] = {
+        { 9, 9, 10 },
+        { 16, 16, 40 },
+        { 30, 16, 99 },
+    };
+
+    // The games print every win and loss
+    std::streambuf* const console = std::cout.rdbuf(nullptr);
+
+    solver::OpeningBook book;
+    for (util::GameSettings const& settings : configurations) {
+        auto const start = std::chrono::steady_clock::now();
+        book.add(settings, simulation::generate_openings(settings, games_per_cell));
+        auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        std::cout.rdbuf(console);
+        std::cout << settings.width << "x" << settings.height << " with " << settings.num_bombs << " mines: "
+            << elapsed.count() << " ms\n";
+        std::cout.rdbuf(nullptr);
+    }
+    std::cout.rdbuf(console);
+
+    if (!book.save(argv[1])) {
+        std::cout << "Could not write " << argv[1] << '\n';
+        return 1;
+    }
+    std::cout << "Wrote " << book.size() << " board configurations to " << argv[1] << '\n';
+    return 0;
+}
@@ -0,0 +1,27 @@
+// gen_patterns.cpp : Writes the pattern table that the solver looks up before searching.
+//
+// Usage: winmine_gen_patterns <output file>
+
+#include <chrono>
+#include <iostream>
+
+#include "../solver/pattern_table.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        std::cout << "Usage: winmine_gen_patterns <output file>\n";
+        return 1;
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    solver::PatternTable const table = solver::PatternTable::generate();
+    auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    if (!table.save(argv[1])) {
+        std::cout << "Could not write " << argv[1] << '\n';
+        return 1;
+    }
+    std::cout << "Wrote " << table.size() << " patterns to " << argv[1] << " in " << elapsed.count() << " ms\n";
+    return 0;
+}
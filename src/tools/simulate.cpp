@@ -0,0 +1,480 @@
+// simulate.cpp : Plays long runs of headless games, spread over worker processes.
+//
+// Usage: winmine_simulate <width> <height> <mines> <games> [workers] [results file]
+//
+// Game i is played with seed i. Every worker process owns a range of games, and writes the result of each into
+// its slot in the results file, which all processes map into memory. The coordinator reads the slots as they
+// fill up and prints the totals. A worker that crashes or gets stuck on a game is killed, that game is marked as
+// failed, and a new worker takes over the rest of its range, unless the workers for it keep exiting before they
+// start a game, then the rest of the range fails. The results file stays behind for later analysis.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "../control/simulation.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A game that takes longer than this is taken to hang its worker
+constexpr std::chrono::seconds game_timeout{ 60 };
+
+// Workers in a row that may exit before they start on a game, before the rest of their range is given up on
+constexpr int max_early_exits = 3;
+
+// The states of a slot. Each is only written by the worker playing the game, except failed.
+enum SlotStatus : std::uint32_t {
+    Pending = 0,
+    Started = 1,
+    Done = 2,
+    Failed = 3, // set by the coordinator when the worker died or hung on this game
+};
+
+struct GameSlot {
+    std::atomic<std::uint32_t> status; // written last, with release, the fields below are valid once it is Done
+    std::uint8_t won;
+    std::uint8_t opened;
+    std::uint16_t unused;
+    std::int32_t moves;
+    std::int32_t guesses;
+    std::int64_t nanoseconds;
+};
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "slots are shared between processes");
+
+struct ResultsHeader {
+    char magic[4];
+    std::uint32_t num_games;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t num_bombs;
+    std::uint32_t unused;
+};
+
+constexpr char results_magic[4] = { 'W', 'M', 'S', 'R' };
+
+std::size_t results_size(std::uint32_t num_games) {
+    return sizeof(ResultsHeader) + num_games * sizeof(GameSlot);
+}
+
+/*
+* A file mapped into memory, shared with every other process that maps it.
+*/
+class SharedFile {
+    void* data = nullptr;
+    std::size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+    SharedFile() = default;
+
+public:
+    SharedFile(SharedFile&& other) noexcept
+        : data{ std::exchange(other.data, nullptr) }
+        , size{ other.size }
+#ifdef _WIN32
+        , file{ std::exchange(other.file, INVALID_HANDLE_VALUE) }
+        , mapping{ std::exchange(other.mapping, nullptr) }
+#endif
+    {}
+    SharedFile(SharedFile&) = delete;
+
+    // Map size bytes of path. A new file is made, zero filled, when create is set.
+    static std::optional<SharedFile> map(std::string const& path, std::size_t size, bool create) {
+        SharedFile shared;
+        shared.size = size;
+#ifdef _WIN32
+        shared.file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (shared.file == INVALID_HANDLE_VALUE) {
+            return {};
+        }
+        shared.mapping = CreateFileMappingA(shared.file, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size), nullptr);
+        if (shared.mapping == nullptr) {
+            return {};
+        }
+        shared.data = MapViewOfFile(shared.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (shared.data == nullptr) {
+            return {};
+        }
+#else
+        int const fd = open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+        if (fd < 0) {
+            return {};
+        }
+        if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            return {};
+        }
+        void* const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd); // the mapping keeps the file
+        if (data == MAP_FAILED) {
+            return {};
+        }
+        shared.data = data;
+#endif
+        return shared;
+    }
+
+    ~SharedFile() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+#else
+        if (data != nullptr) {
+            munmap(data, size);
+        }
+#endif
+    }
+
+    ResultsHeader& header() const {
+        return *static_cast<ResultsHeader*>(data);
+    }
+    GameSlot* slots() const {
+        return reinterpret_cast<GameSlot*>(static_cast<char*>(data) + sizeof(ResultsHeader));
+    }
+};
+
+/*
+* A child process running this program with other arguments.
+*/
+class Process {
+#ifdef _WIN32
+    PROCESS_INFORMATION info{};
+#else
+    pid_t pid = -1;
+#endif
+
+public:
+    static std::optional<Process> spawn(std::string const& program, std::vector<std::string> const& args) {
+        Process process;
+#ifdef _WIN32
+        std::string command_line = '"' + program + '"';
+        for (std::string const& arg : args) {
+            command_line += " \"" + arg + '"';
+        }
+        STARTUPINFOA startup{};
+        startup.cb = sizeof(startup);
+        if (!CreateProcessA(program.c_str(), command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process.info)) {
+            return {};
+        }
+        CloseHandle(process.info.hThread);
+#else
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(program.c_str()));
+        for (std::string const& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        if (posix_spawnp(&process.pid, program.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+            return {};
+        }
+#endif
+        return process;
+    }
+
+    // Empty while the process runs, otherwise whether it exited cleanly
+    std::optional<bool> poll() {
+#ifdef _WIN32
+        if (WaitForSingleObject(info.hProcess, 0) != WAIT_OBJECT_0) {
+            return {};
+        }
+        DWORD exit_code = 1;
+        GetExitCodeProcess(info.hProcess, &exit_code);
+        CloseHandle(info.hProcess);
+        return exit_code == 0;
+#else
+        int status = 0;
+        if (waitpid(pid, &status, WNOHANG) == 0) {
+            return {};
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+    }
+
+    void kill() {
+#ifdef _WIN32
+        TerminateProcess(info.hProcess, 1);
+        WaitForSingleObject(info.hProcess, INFINITE);
+        CloseHandle(info.hProcess);
+#else
+        ::kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+#endif
+    }
+};
+
+std::string this_program(char const* argv0) {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    if (GetModuleFileNameA(nullptr, path, MAX_PATH) > 0) {
+        return path;
+    }
+#endif
+    return argv0;
+}
+
+// Play games [first, end) into their slots. Games that already have a result are skipped.
+int run_worker(std::string const& path, std::uint32_t first, std::uint32_t end) {
+    std::optional<SharedFile> header_only = SharedFile::map(path, sizeof(ResultsHeader), false);
+    if (!header_only) {
+        return 1;
+    }
+    std::uint32_t const num_games = header_only->header().num_games;
+    std::optional<SharedFile> results = SharedFile::map(path, results_size(num_games), false);
+    if (!results || std::memcmp(results->header().magic, results_magic, 4) != 0 || end > num_games) {
+        return 1;
+    }
+    ResultsHeader const& header = results->header();
+    util::GameSettings const settings{ header.width, header.height, header.num_bombs };
+
+    std::cout.rdbuf(nullptr); // the games print every win and loss
+    for (std::uint32_t i = first; i < end; ++i) {
+        GameSlot& slot = results->slots()[i];
+        if (slot.status.load(std::memory_order_acquire) != Pending) {
+            continue;
+        }
+        slot.status.store(Started, std::memory_order_release);
+
+        auto const start = Clock::now();
+        simulation::GameResult const game = simulation::play_game(settings, i);
+        slot.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        slot.won = game.won;
+        slot.opened = game.opened;
+        slot.moves = game.moves;
+        slot.guesses = game.guesses;
+        slot.status.store(Done, std::memory_order_release);
+    }
+    return 0;
+}
+
+struct Totals {
+    std::uint32_t done = 0;
+    std::uint32_t failed = 0;
+    std::uint32_t won = 0;
+    std::int64_t moves = 0;
+    std::int64_t guesses = 0;
+    std::int64_t nanoseconds = 0;
+};
+
+Totals count_totals(SharedFile const& results) {
+    Totals totals;
+    for (std::uint32_t i = 0; i < results.header().num_games; ++i) {
+        GameSlot const& slot = results.slots()[i];
+        std::uint32_t const status = slot.status.load(std::memory_order_acquire);
+        if (status == Failed) {
+            ++totals.failed;
+        }
+        else if (status == Done) {
+            ++totals.done;
+            totals.won += slot.won;
+            totals.moves += slot.moves;
+            totals.guesses += slot.guesses;
+            totals.nanoseconds += slot.nanoseconds;
+        }
+    }
+    return totals;
+}
+
+void print_totals(Totals const& totals, std::uint32_t num_games, Clock::duration elapsed) {
+    double const seconds = std::chrono::duration<double>(elapsed).count();
+    double const done = std::max<std::uint32_t>(totals.done, 1);
+    std::cout << totals.done << "/" << num_games << " games"
+        << ", won " << 100. * totals.won / done << "%"
+        << ", " << totals.moves / done << " moves"
+        << ", " << totals.guesses / done << " guesses"
+        << ", " << totals.nanoseconds / done / 1e6 << " ms per game"
+        << ", " << totals.done / std::max(seconds, 1e-3) << " games/s";
+    if (totals.failed > 0) {
+        std::cout << ", " << totals.failed << " failed";
+    }
+    std::cout << '\n';
+}
+
+/*
+* One range of games, and the worker that plays it. The worker plays its games in order, so the first game
+* in the range that isn't done is the one it is on.
+*/
+struct Shard {
+    std::uint32_t first;
+    std::uint32_t end;
+    std::optional<Process> worker;
+    std::uint32_t current = 0;             // game the worker was last seen on
+    Clock::time_point current_since;       // when it was first seen on it
+    int num_early_exits = 0;               // workers in a row that were gone before they started a game
+};
+
+std::uint32_t first_unfinished(SharedFile const& results, Shard const& shard) {
+    std::uint32_t i = shard.first;
+    while (i < shard.end && results.slots()[i].status.load(std::memory_order_acquire) >= Done) {
+        ++i;
+    }
+    return i;
+}
+
+int run_coordinator(std::string const& program, util::GameSettings settings, std::uint32_t num_games, int num_workers, std::string const& path) {
+    std::optional<SharedFile> results = SharedFile::map(path, results_size(num_games), true);
+    if (!results) {
+        std::cout << "Could not create " << path << '\n';
+        return 1;
+    }
+    ResultsHeader& header = results->header();
+    std::memcpy(header.magic, results_magic, 4);
+    header.num_games = num_games;
+    header.width = settings.width;
+    header.height = settings.height;
+    header.num_bombs = settings.num_bombs;
+
+    std::vector<Shard> shards;
+    for (int w = 0; w < num_workers; ++w) {
+        std::uint32_t const first = static_cast<std::uint32_t>(std::uint64_t{ num_games } * w / num_workers);
+        std::uint32_t const end = static_cast<std::uint32_t>(std::uint64_t{ num_games } * (w + 1) / num_workers);
+        if (first < end) {
+            Shard shard;
+            shard.first = first;
+            shard.end = end;
+            shards.push_back(std::move(shard));
+        }
+    }
+
+    auto start_worker = [&](Shard& shard) {
+        shard.current = first_unfinished(*results, shard);
+        shard.current_since = Clock::now();
+        if (shard.current < shard.end) {
+            shard.worker = Process::spawn(program,
+                { "--worker", path, std::to_string(shard.current), std::to_string(shard.end) });
+            if (!shard.worker) {
+                std::cout << "Could not start a worker for games " << shard.current << " to " << shard.end << '\n';
+            }
+        }
+    };
+    /*
+    * The worker is gone, the game it was on failed, unless it was done with it. Workers that keep exiting before
+    * they start a game aren't going to get any further, the rest of their range fails then, and none is started.
+    */
+    auto fail_current = [&](Shard& shard) {
+        shard.worker.reset();
+        std::uint32_t const current = first_unfinished(*results, shard);
+        if (current == shard.end) {
+            return;
+        }
+        if (results->slots()[current].status.load(std::memory_order_acquire) == Started) {
+            results->slots()[current].status.store(Failed, std::memory_order_release);
+            std::cout << "Game " << current << " failed\n";
+            shard.num_early_exits = 0;
+        }
+        else if (++shard.num_early_exits >= max_early_exits) {
+            std::cout << "Workers for games " << current << " to " << shard.end << " keep exiting before they start, "
+                << "these games failed\n";
+            for (std::uint32_t i = current; i < shard.end; ++i) {
+                results->slots()[i].status.store(Failed, std::memory_order_release);
+            }
+        }
+    };
+
+    auto const start = Clock::now();
+    for (Shard& shard : shards) {
+        start_worker(shard);
+    }
+
+    auto next_report = start + std::chrono::seconds{ 1 };
+    while (true) {
+        bool any_running = false;
+        for (Shard& shard : shards) {
+            if (!shard.worker) {
+                continue;
+            }
+            if (std::optional<bool> const exited = shard.worker->poll()) {
+                if (!*exited || first_unfinished(*results, shard) < shard.end) {
+                    fail_current(shard);
+                    start_worker(shard);
+                }
+                else {
+                    shard.worker.reset();
+                }
+            }
+            else {
+                std::uint32_t const current = first_unfinished(*results, shard);
+                if (current != shard.current) {
+                    shard.current = current;
+                    shard.current_since = Clock::now();
+                }
+                else if (Clock::now() - shard.current_since > game_timeout) {
+                    shard.worker->kill();
+                    fail_current(shard);
+                    start_worker(shard);
+                }
+            }
+            any_running = any_running || shard.worker.has_value();
+        }
+        if (!any_running) {
+            break;
+        }
+
+        if (Clock::now() >= next_report) {
+            print_totals(count_totals(*results), num_games, Clock::now() - start);
+            next_report += std::chrono::seconds{ 1 };
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+    }
+
+    print_totals(count_totals(*results), num_games, Clock::now() - start);
+    std::cout << "Results are in " << path << '\n';
+    return 0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc == 5 && std::string{ argv[1] } == "--worker") {
+        return run_worker(argv[2], std::stoul(argv[3]), std::stoul(argv[4]));
+    }
+
+    if (argc < 5 || argc > 7) {
+        std::cout << "Usage: winmine_simulate <width> <height> <mines> <games> [workers] [results file]\n";
+        return 1;
+    }
+    util::GameSettings const settings{ std::stoi(argv[1]), std::stoi(argv[2]), std::stoi(argv[3]) };
+    std::uint32_t const num_games = std::stoul(argv[4]);
+    int const num_workers = argc >= 6 ?
+        std::stoi(argv[5]) :
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::string const path = argc == 7 ? argv[6] : "simulation.bin";
+
+    return run_coordinator(this_program(argv[0]), settings, num_games, num_workers, path);
+}
@@ -1,5 +1,7 @@
 #include "gui.h"
 
+#include "../lib/trace.h"
+
 void NewGameForm::place_components() {
     nana::place place{ *this };
     place.div("vert<textwidth><textheight><textmines><cancel><start><label>");
@@ -62,7 +64,7 @@ NewGameForm::NewGameForm(StartCallback start_cb)
 void Gui::show_new_game_dialog() {
     new_game_form = std::make_unique<NewGameForm>([this](util::GameSettings new_game_settings) {
         game_settings = new_game_settings;
-        create_buttons();
+        // The canvas takes the new size from the snapshot of the new game, deltas still on their way are of the old one
         place_components();
         control->new_game(game_settings);
         });
@@ -79,6 +81,12 @@ void Gui::fill_menu_bar() {
     game_item.append("New game", [this](nana::menu::item_proxy&) {
         show_new_game_dialog();
         });
+    game_item.append("Undo", [this](nana::menu::item_proxy&) {
+        control->undo();
+        });
+    game_item.append("Redo", [this](nana::menu::item_proxy&) {
+        control->redo();
+        });
 
     nana::menu& solver_item = menubar.push_back("&Solver");
     solver_item.append("One move", [this](nana::menu::item_proxy&) {
@@ -88,54 +96,27 @@ void Gui::fill_menu_bar() {
         control->auto_flag_bombs();
         });
     solver_item.append("Autoplay", [this](nana::menu::item_proxy&) {
-        nana::threads::pool_push(thread_pool, [this]() {
-            using namespace std::chrono_literals;
-            control->auto_play(0ms);
-            })();
+        using namespace std::chrono_literals;
+        control->auto_play(0ms);
         });
     solver_item.append("Autoplay with delay", [this](nana::menu::item_proxy&) {
-        nana::threads::pool_push(thread_pool, [this]() {
-            using namespace std::chrono_literals;
-            control->auto_play(80ms);
-            })();
+        using namespace std::chrono_literals;
+        control->auto_play(80ms);
+        });
+    solver_item.append("Stop autoplay", [this](nana::menu::item_proxy&) {
+        control->stop_autoplay();
         });
-}
-
-void Gui::create_buttons() {
-    mine_buttons.clear();
-    for (int x = 0, y = 0; y < game_settings.height;) {
-        mine_buttons.emplace_back(std::make_unique<nana::button>(form, " "));
-        mine_buttons.back()->events().mouse_up([this, x, y](nana::arg_mouse const& arg) {
-            if (arg.button == nana::mouse::left_button) {
-                control->expose({ x, y });
-            }
-            else if (arg.button == nana::mouse::right_button) {
-                control->toggle_flagged({ x, y });
-            }
-            });
-        y = x < game_settings.width - 1 ? y : y + 1;
-        x = x < game_settings.width - 1 ? x + 1 : 0;
-    }
 }
 
 void Gui::place_components() {
+    // Big boards get a window that fits on the screen, the canvas scrolls
+    nana::size const desktop = nana::screen::desktop_size();
+    unsigned int const chrome_height = menubar_height + status_line_height;
     form.size(nana::size(
-        game_settings.width * cell_width_pixels,
-        game_settings.height * cell_width_pixels + menubar_height + status_line_height));
+        std::min(game_settings.width * cell_width_pixels, desktop.width * 9 / 10),
+        std::min(game_settings.height * cell_width_pixels + chrome_height, desktop.height * 9 / 10)));
 
-    //Layout management
-    nana::place place = nana::place{ form };
-    place.div("vert<menubar weight=" + std::to_string(menubar_height) + ">"
-        "<minefield "
-        "grid=[" + std::to_string(game_settings.width) + "," + std::to_string(game_settings.height) + "]>"
-        "vert<statusline weight=" + std::to_string(status_line_height) + ">"
-    );
-    place["menubar"] << menubar;
-    for (auto const& cell : mine_buttons) {
-        place["minefield"] << *cell;
-    }
-    place["statusline"] << status_line;
-    place.collocate();
+    layout.collocate();
 }
 
 Gui::Gui(util::GameSettings settings, std::shared_ptr<Controller> control)
@@ -143,20 +124,47 @@ Gui::Gui(util::GameSettings settings, std::shared_ptr<Controller> control)
     , control{ control }
     , form{}
     , menubar{ form }
+    , canvas{ form, cell_width_pixels }
     , status_line{ form }
+    , layout{ form }
 {
     fill_menu_bar();
 
-    create_buttons();
+    //Layout management
+    layout.div("vert<menubar weight=" + std::to_string(menubar_height) + ">"
+        "<minefield>"
+        "<statusline weight=" + std::to_string(status_line_height) + ">"
+    );
+    layout["menubar"] << menubar;
+    layout["minefield"] << canvas;
+    layout["statusline"] << status_line;
+
+    canvas.reset(game_settings.width, game_settings.height);
+    canvas.set_click_callbacks(
+        [this](util::Pos pos) { control->expose(pos); },
+        [this](util::Pos pos) { control->toggle_flagged(pos); },
+        [this](util::Pos pos) { control->chord(pos); });
 
     place_components();
 
-    control->set_update_view_callback([this](Minefield const& mf) {
-        show_minefield(mf);
-        });
+    subscription = control->subscribe_deltas(
+        [this](BoardDelta const& delta) { show_changes(delta); },
+        [this](std::shared_ptr<Minefield const> const& mf) { show_minefield(*mf); });
+
+    status_timer.interval(std::chrono::milliseconds{ 100 });
+    status_timer.elapse([this]() { update_status_line(); });
+    status_timer.start();
+}
+
+Gui::~Gui() {
+    status_timer.stop();
+    // The controller may outlive us, make sure it is done calling back
+    control->unsubscribe(subscription);
+    control->snapshot();
 }
 
 void Gui::start() {
+    TRACE_THREAD_NAME("gui");
     form.show();
 
     //Start to event loop process, it blocks until the form is closed.
@@ -167,33 +175,41 @@ void Gui::start() {
 
 void Gui::show_minefield(Minefield const& minefield) {
 
-    for (auto const& [pos, cell] : minefield) {
-        nana::button& btn = *mine_buttons[pos.y * game_settings.width + pos.x];
-        if (cell.is_exposed()) {
-            if (cell.is_bomb()) {
-                btn.caption("x");
-            }
-            else if (cell.get_num_adjacent_bombs() > 0) {
-                btn.caption(std::to_string(cell.get_num_adjacent_bombs()));
-            }
-            else {
-                btn.caption("_"); // pressed but no adjacent mines
-            }
-        }
-        else if (cell.is_flagged()) {
-            btn.caption("B");
-        }
-        else {
-            btn.caption(" ");
-        }
-    }
-    if (minefield.is_game_lost()) {
-        status_line.caption("You lost");
+    canvas.show(minefield);
+    set_game_state(minefield.get_state());
+}
+
+// Callback used when some cells have changed, only those are drawn again
+
+void Gui::show_changes(BoardDelta const& delta) {
+    canvas.show(delta.cells);
+    if (delta.game_state) {
+        set_game_state(*delta.game_state);
     }
-    else if (minefield.is_game_won()) {
-        status_line.caption("You won");
+}
+
+// Runs on the controller thread, the status line picks it up on the next timer tick
+void Gui::set_game_state(GameState state) {
+    game_state = state;
+    game_state_changed = true;
+}
+
+/*
+* Runs on the GUI thread, from the timer. Searches that are done within one tick are never shown, and a game that
+* is over keeps saying so.
+*/
+void Gui::update_status_line() {
+    GameState const state = game_state;
+    bool const changed = game_state_changed.exchange(false);
+    bool const game_over = state == GameState::Lost || state == GameState::Won;
+
+    std::optional<double> const progress = control->search_progress();
+    if (progress && !game_over) {
+        status_line.caption("Solving... " + std::to_string(static_cast<int>(*progress * 100)) + "%");
+        showing_progress = true;
     }
-    else {
-        status_line.caption("");
+    else if (changed || showing_progress) {
+        showing_progress = false;
+        status_line.caption(state == GameState::Lost ? "You lost" : state == GameState::Won ? "You won" : "");
     }
 }
@@ -1,16 +1,20 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <chrono>
 #include <optional>
+#include <algorithm>
 
 #include <nana/gui.hpp>
 #include <nana/gui/widgets/button.hpp>
 #include <nana/gui/widgets/menubar.hpp>
 #include <nana/gui/widgets/textbox.hpp>
 #include <nana/gui/widgets/label.hpp>
-#include <nana/threads/pool.hpp>
+#include <nana/gui/screen.hpp>
+#include <nana/gui/timer.hpp>
 
+#include "minefield_canvas.h"
 #include "../control/controller.h"
 
 class NewGameForm : public nana::form {
@@ -25,6 +29,7 @@ class NewGameForm : public nana::form {
 	StartCallback start_cb;
 
     void place_components();
+    void show_game_state(GameState state);
     void start_game();
     std::optional<util::GameSettings> get_settings();
 
@@ -39,27 +44,40 @@ class Gui {
 
 	nana::form form;
 	nana::menubar menubar;
-	std::vector<std::unique_ptr<nana::button>> mine_buttons;
+	MinefieldCanvas canvas;
 	nana::label status_line;
+	nana::place layout;
 	std::unique_ptr<NewGameForm> new_game_form;
 
-	std::shared_ptr<Controller> control;
-	nana::threads::pool thread_pool;
+	std::shared_ptr<Controller> control; // runs its own thread, callbacks below are called from there
+	Controller::SubscriptionId subscription;
     util::GameSettings game_settings;
 
+	// The status line shows how far a slow search is, instead of the game state. Only the GUI thread sets it,
+	// from the timer, the controller thread just leaves the game state here.
+	nana::timer status_timer;
+	std::atomic<GameState> game_state{ GameState::Uninitialized };
+	std::atomic<bool> game_state_changed{ true };
+	bool showing_progress = false; // GUI thread only
+
     void show_new_game_dialog();
 
     void fill_menu_bar();
-    void create_buttons();
     void place_components();
+    void set_game_state(GameState state);
+    void update_status_line();
 
 public:
     Gui(util::GameSettings settings, std::shared_ptr<Controller> control);
 	Gui(Gui&) = delete;
+    ~Gui();
 
     void start();
 
-	// Callback used when the minefield has updated, and we need to show the new state
+	// Callback used when the whole minefield has to be shown, e.g. for a new game
     void show_minefield(Minefield const& minefield);
 
+	// Callback used when some cells on the minefield have changed
+    void show_changes(BoardDelta const& delta);
+
 };
\ No newline at end of file
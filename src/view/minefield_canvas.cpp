@@ -0,0 +1,270 @@
+#include "minefield_canvas.h"
+
+#include "../lib/trace.h"
+
+#include <algorithm>
+#include <string>
+
+using util::Pos;
+
+namespace {
+
+nana::color const covered_color{ 190, 190, 190 };
+nana::color const exposed_color{ 230, 230, 230 };
+nana::color const grid_color{ 128, 128, 128 };
+nana::color const flag_color{ 200, 0, 0 };
+nana::color const bomb_color{ 0, 0, 0 };
+nana::color const number_colors[9] = {
+	{ 0, 0, 0 },       // 0 is never drawn
+	{ 0, 0, 255 },
+	{ 0, 128, 0 },
+	{ 255, 0, 0 },
+	{ 0, 0, 128 },
+	{ 128, 0, 0 },
+	{ 0, 128, 128 },
+	{ 0, 0, 0 },
+	{ 128, 128, 128 },
+};
+
+void draw_centered_text(nana::paint::graphics& graph, nana::rectangle const& r, std::string const& text, nana::color const& color) {
+	nana::size const extent = graph.text_extent_size(text);
+	graph.string({
+		r.x + (static_cast<int>(r.width) - static_cast<int>(extent.width)) / 2,
+		r.y + (static_cast<int>(r.height) - static_cast<int>(extent.height)) / 2 },
+		text, color);
+}
+
+} // end anonymous namespace
+
+MinefieldCanvas::MinefieldCanvas(nana::window parent, unsigned int cell_pixels)
+	: nana::panel<true>{ parent }
+	, cell_pixels{ cell_pixels }
+{
+	drawing.draw([this](nana::paint::graphics& graph) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (!view_buffer.empty()) {
+			graph.bitblt(nana::rectangle{ graph.size() }, view_buffer, { 0, 0 });
+		}
+		});
+
+	events().resized([this](nana::arg_resized const& arg) {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			view_buffer.make({ arg.width, arg.height });
+			update_font();
+			clamp_scroll_offset();
+			repaint_all();
+		}
+		drawing.update();
+		});
+
+	events().mouse_up([this](nana::arg_mouse const& arg) {
+		std::optional<Pos> pos;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			pos = cell_at(arg.pos);
+		}
+		// The callbacks update the minefield, which calls back into show(), so don't hold the lock
+		if (!pos) {
+			return;
+		}
+		if (arg.button == nana::mouse::left_button && on_left_click) {
+			on_left_click(*pos);
+		}
+		else if (arg.button == nana::mouse::right_button && on_right_click) {
+			on_right_click(*pos);
+		}
+		else if (arg.button == nana::mouse::middle_button && on_middle_click) {
+			on_middle_click(*pos);
+		}
+		});
+
+	events().mouse_wheel([this](nana::arg_wheel const& arg) {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (arg.ctrl) {
+				zoom_at(arg.pos, arg.upwards);
+			}
+			else {
+				int const step = scroll_step_cells * static_cast<int>(this->cell_pixels) * (arg.upwards ? -1 : 1);
+				if (arg.shift || arg.which == nana::arg_wheel::wheel::horizontal) {
+					scroll_by(step, 0);
+				}
+				else {
+					scroll_by(0, step);
+				}
+			}
+		}
+		drawing.update();
+		});
+}
+
+std::uint8_t MinefieldCanvas::look_of(Cell const& cell) {
+	if (cell.is_exposed()) {
+		return cell.is_bomb() ? Bomb : static_cast<std::uint8_t>(cell.get_num_adjacent_bombs());
+	}
+	return cell.is_flagged() ? Flagged : Covered;
+}
+
+void MinefieldCanvas::reset(int width, int height) {
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		board_width = width;
+		board_height = height;
+		shown.assign(width * height, Covered);
+		scroll_offset = { 0, 0 };
+		repaint_all();
+	}
+	drawing.update();
+}
+
+void MinefieldCanvas::show(Minefield const& minefield) {
+	TRACE_SCOPE("redraw board");
+	if (minefield.get_width() != board_width || minefield.get_height() != board_height) {
+		reset(minefield.get_width(), minefield.get_height());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto const& [pos, cell] : minefield) {
+			std::uint8_t const look = look_of(cell);
+			std::uint8_t& shown_look = shown[pos.y * board_width + pos.x];
+			if (look != shown_look) {
+				shown_look = look;
+				if (is_visible(pos)) {
+					paint_cell(pos);
+				}
+			}
+		}
+	}
+	drawing.update();
+}
+
+void MinefieldCanvas::show(std::vector<CellChange> const& changes) {
+	TRACE_SCOPE("redraw cells");
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (CellChange const& change : changes) {
+			// Changes to a board of another size, from before a new game's snapshot got here
+			if (change.pos.x < 0 || change.pos.y < 0 || change.pos.x >= board_width || change.pos.y >= board_height) {
+				continue;
+			}
+			shown[change.pos.y * board_width + change.pos.x] = look_of(change.cell);
+			if (is_visible(change.pos)) {
+				paint_cell(change.pos);
+			}
+		}
+	}
+	drawing.update();
+}
+
+void MinefieldCanvas::set_click_callbacks(CellCallback left, CellCallback right, CellCallback middle) {
+	on_left_click = left;
+	on_right_click = right;
+	on_middle_click = middle;
+}
+
+void MinefieldCanvas::paint_cell(Pos pos) {
+	nana::rectangle const r = cell_rectangle(pos);
+	std::uint8_t const look = shown[pos.y * board_width + pos.x];
+
+	view_buffer.rectangle(r, true, look <= 8 || look == Bomb ? exposed_color : covered_color);
+	view_buffer.rectangle(r, false, grid_color);
+
+	if (look == Flagged) {
+		draw_centered_text(view_buffer, r, "B", flag_color);
+	}
+	else if (look == Bomb) {
+		draw_centered_text(view_buffer, r, "x", bomb_color);
+	}
+	else if (look > 0 && look <= 8) {
+		draw_centered_text(view_buffer, r, std::to_string(look), number_colors[look]);
+	}
+}
+
+void MinefieldCanvas::repaint_all() {
+	if (view_buffer.empty()) {
+		return;
+	}
+	view_buffer.rectangle(true, bgcolor()); // the area right of or below a small board
+
+	nana::size const view = view_buffer.size();
+	int const first_x = scroll_offset.x / static_cast<int>(cell_pixels);
+	int const first_y = scroll_offset.y / static_cast<int>(cell_pixels);
+	int const last_x = std::min(board_width, (scroll_offset.x + static_cast<int>(view.width)) / static_cast<int>(cell_pixels) + 1);
+	int const last_y = std::min(board_height, (scroll_offset.y + static_cast<int>(view.height)) / static_cast<int>(cell_pixels) + 1);
+	for (int y = first_y; y < last_y; ++y) {
+		for (int x = first_x; x < last_x; ++x) {
+			paint_cell({ x, y });
+		}
+	}
+}
+
+void MinefieldCanvas::update_font() {
+	if (!view_buffer.empty()) {
+		view_buffer.typeface(nana::paint::font{ nana::paint::font{}.name(), cell_pixels * .5 });
+	}
+}
+
+void MinefieldCanvas::scroll_by(int dx, int dy) {
+	scroll_offset.x += dx;
+	scroll_offset.y += dy;
+	clamp_scroll_offset();
+	repaint_all();
+}
+
+// Zoom in or out, keeping the board point under the mouse in place
+void MinefieldCanvas::zoom_at(nana::point anchor, bool zoom_in) {
+	unsigned int const old_pixels = cell_pixels;
+	unsigned int const new_pixels = zoom_in ? old_pixels * 5 / 4 + 1 : old_pixels * 4 / 5;
+	cell_pixels = std::clamp(new_pixels, min_cell_pixels, max_cell_pixels);
+	if (cell_pixels == old_pixels) {
+		return;
+	}
+
+	scroll_offset.x = (scroll_offset.x + anchor.x) * static_cast<int>(cell_pixels) / static_cast<int>(old_pixels) - anchor.x;
+	scroll_offset.y = (scroll_offset.y + anchor.y) * static_cast<int>(cell_pixels) / static_cast<int>(old_pixels) - anchor.y;
+	clamp_scroll_offset();
+	update_font();
+	repaint_all();
+}
+
+void MinefieldCanvas::clamp_scroll_offset() {
+	nana::size const view = view_buffer.size();
+	int const max_x = std::max(0, board_width * static_cast<int>(cell_pixels) - static_cast<int>(view.width));
+	int const max_y = std::max(0, board_height * static_cast<int>(cell_pixels) - static_cast<int>(view.height));
+	scroll_offset.x = std::clamp(scroll_offset.x, 0, max_x);
+	scroll_offset.y = std::clamp(scroll_offset.y, 0, max_y);
+}
+
+bool MinefieldCanvas::is_visible(Pos pos) const {
+	if (view_buffer.empty()) {
+		return false;
+	}
+	nana::rectangle const r = cell_rectangle(pos);
+	nana::size const view = view_buffer.size();
+	return r.x + static_cast<int>(r.width) > 0 && r.x < static_cast<int>(view.width)
+		&& r.y + static_cast<int>(r.height) > 0 && r.y < static_cast<int>(view.height);
+}
+
+// Where the cell is drawn, in widget coordinates
+nana::rectangle MinefieldCanvas::cell_rectangle(Pos pos) const {
+	return {
+		pos.x * static_cast<int>(cell_pixels) - scroll_offset.x,
+		pos.y * static_cast<int>(cell_pixels) - scroll_offset.y,
+		cell_pixels,
+		cell_pixels };
+}
+
+std::optional<Pos> MinefieldCanvas::cell_at(nana::point pixel) const {
+	int const x = pixel.x + scroll_offset.x;
+	int const y = pixel.y + scroll_offset.y;
+	if (x < 0 || y < 0) {
+		return {};
+	}
+	Pos const pos{ x / static_cast<int>(cell_pixels), y / static_cast<int>(cell_pixels) };
+	if (pos.x >= board_width || pos.y >= board_height) {
+		return {};
+	}
+	return pos;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <nana/gui.hpp>
+#include <nana/gui/drawing.hpp>
+#include <nana/gui/widgets/panel.hpp>
+#include <nana/paint/graphics.hpp>
+
+#include "../control/controller.h"
+#include "../model/minefield.h"
+#include "../lib/util.h"
+
+/*
+* Draws the whole minefield on one widget, instead of one native button per cell.
+* The visible part of the board is kept in an off-screen buffer. When the minefield changes, only the cells that
+* look different from last time are painted again. Cells are found from mouse positions by pixel math.
+* Mouse wheel scrolls, shift+wheel scrolls sideways and ctrl+wheel zooms, for boards larger than the window.
+*/
+class MinefieldCanvas : public nana::panel<true> {
+	using CellCallback = std::function<void(util::Pos)>;
+
+	static constexpr unsigned int min_cell_pixels = 8;
+	static constexpr unsigned int max_cell_pixels = 64;
+	static constexpr int scroll_step_cells = 3;
+
+	// What a cell shows, 0-8 are exposed numbers
+	enum Look : std::uint8_t {
+		Covered = 9,
+		Flagged,
+		Bomb
+	};
+
+	nana::drawing drawing{ *this };
+	nana::paint::graphics view_buffer; // the visible part of the board, same size as the widget
+
+	std::mutex mutex; // show() runs on the controller thread, from its subscription callbacks, while the GUI thread draws
+	int board_width = 0;
+	int board_height = 0;
+	std::vector<std::uint8_t> shown; // Look of every cell, the visible ones are painted like this in view_buffer
+	unsigned int cell_pixels = 20;
+	nana::point scroll_offset{ 0, 0 }; // board pixel shown in the top left corner of the widget
+
+	CellCallback on_left_click;
+	CellCallback on_right_click;
+	CellCallback on_middle_click;
+
+	static std::uint8_t look_of(Cell const& cell);
+
+	void paint_cell(util::Pos pos);
+	void repaint_all();
+	void update_font();
+	void scroll_by(int dx, int dy);
+	void zoom_at(nana::point anchor, bool zoom_in);
+	void clamp_scroll_offset();
+	bool is_visible(util::Pos pos) const;
+	nana::rectangle cell_rectangle(util::Pos pos) const;
+	std::optional<util::Pos> cell_at(nana::point pixel) const;
+
+public:
+	MinefieldCanvas(nana::window parent, unsigned int cell_pixels);
+
+	// Start over with a board of a new size, everything is painted again
+	void reset(int width, int height);
+
+	// Paint the cells that changed since the last call
+	void show(Minefield const& minefield);
+
+	// Paint only the listed cells, without looking at the rest of the board
+	void show(std::vector<CellChange> const& changes);
+
+	void set_click_callbacks(CellCallback left, CellCallback right, CellCallback middle);
+};
@@ -7,9 +7,15 @@
 #include "model/minefield.h"
 #include "view/gui.h"
 #include "control/controller.h"
+#include "lib/metrics.h"
+#include "solver/opening_book.h"
+#include "solver/pattern_table.h"
 
 
-int main()
+// Usage: winmine [metrics file]
+// With a metrics file, statistics of the games autoplay plays are written there every ten seconds, as JSON
+// when it ends in .json and as Prometheus text otherwise.
+int main(int argc, char* argv[])
 {
     util::GameSettings const settings{
         10 // height
@@ -17,6 +23,20 @@ int main()
         , 10 // num_bombs
     };
 
+	// Written by the winmine_gen_patterns tool, the solver works without it, only slower
+	if (std::optional<solver::PatternTable> table = solver::PatternTable::load("patterns.bin")) {
+		solver::set_pattern_table(std::make_shared<solver::PatternTable const>(std::move(*table)));
+	}
+	// Written by the winmine_gen_openings tool, without it the first click goes where a zero is most likely
+	if (std::optional<solver::OpeningBook> book = solver::OpeningBook::load("openings.bin")) {
+		solver::set_opening_book(std::make_shared<solver::OpeningBook const>(std::move(*book)));
+	}
+
+	std::optional<util::metrics::FileExporter> metrics;
+	if (argc > 1) {
+		metrics.emplace(argv[1], std::chrono::seconds{ 10 });
+	}
+
 	std::shared_ptr<Controller> control = std::make_shared<Controller>(
 		Minefield{ settings }
 	);